@@ -0,0 +1,58 @@
+#pragma once
+#include <cstdint>
+#include <vector>
+
+#include "ColorRGB.hpp"
+
+namespace dae
+{
+/**
+ * \brief Running sum of progressive samples per pixel. Every pass adds one sample to each pixel, the displayed color is
+ * the average so far. Anything that changes the image (camera, geometry, settings) has to Reset() it.
+ */
+class AccumulationBuffer final
+{
+public:
+    AccumulationBuffer() = default;
+    explicit AccumulationBuffer(int pixelCount);
+    ~AccumulationBuffer() = default;
+
+    AccumulationBuffer(const AccumulationBuffer&) = delete;
+    AccumulationBuffer(AccumulationBuffer&&) noexcept = delete;
+    AccumulationBuffer& operator=(const AccumulationBuffer&) = delete;
+    AccumulationBuffer& operator=(AccumulationBuffer&&) noexcept = delete;
+
+    void Reset();
+
+    void AddSample(int pixelIdx, const ColorRGB& color)
+    {
+        m_Red[pixelIdx] += color.r;
+        m_Green[pixelIdx] += color.g;
+        m_Blue[pixelIdx] += color.b;
+    }
+
+    // Call once every pixel received its sample of the current pass
+    void EndPass()
+    {
+        ++m_SampleCount;
+    }
+
+    [[nodiscard]] ColorRGB GetAverage(int pixelIdx) const
+    {
+        const float weight{ m_SampleCount > 0 ? 1.f / static_cast<float>(m_SampleCount) : 0.f };
+        return { .r = m_Red[pixelIdx] * weight, .g = m_Green[pixelIdx] * weight, .b = m_Blue[pixelIdx] * weight };
+    }
+
+    [[nodiscard]] uint32_t GetSampleCount() const
+    {
+        return m_SampleCount;
+    }
+
+private:
+    uint32_t m_SampleCount{};
+
+    std::vector<float> m_Red;
+    std::vector<float> m_Green;
+    std::vector<float> m_Blue;
+};
+}  // namespace dae
@@ -1,4 +1,5 @@
 #pragma once
+#include <algorithm>
 #include <cassert>
 #include <cmath>
 #include <stdexcept>
@@ -105,4 +106,75 @@ static float GeometryFunction_Smith(const Vector3& n, const Vector3& v, const Ve
     return GeometryFunction_SchlickGGX(n, v, roughness) * GeometryFunction_SchlickGGX(n, l, roughness);
 }
 
+/**
+ * \brief Transforms a direction from the local frame around n (z up) to world space
+ * \param n Normal of the surface
+ * \param local Direction in the local frame
+ * \return World space direction
+ */
+static Vector3 LocalToWorld(const Vector3& n, const Vector3& local)
+{
+    // Branchless orthonormal basis (Duff et al. 2017)
+    const float sign{ std::copysign(1.f, n.z) };
+    const float a{ -1.f / (sign + n.z) };
+    const float b{ n.x * n.y * a };
+    const Vector3 tangent{ 1.f + (sign * n.x * n.x * a), sign * b, -sign * n.x };
+    const Vector3 bitangent{ b, sign + (n.y * n.y * a), -n.y };
+
+    return (tangent * local.x) + (bitangent * local.y) + (n * local.z);
+}
+
+/**
+ * \brief Cosine weighted hemisphere sample around n, pdf = cos(theta) / PI
+ * \param n Normal of the surface
+ * \param u1 Uniform random number in [0, 1)
+ * \param u2 Uniform random number in [0, 1)
+ * \return Normalized sampled direction
+ */
+static Vector3 SampleCosineHemisphere(const Vector3& n, float u1, float u2)
+{
+    const float radius{ std::sqrt(u1) };
+    const float phi{ PI_2 * u2 };
+    return LocalToWorld(n, { radius * std::cos(phi), radius * std::sin(phi), std::sqrt(std::max(0.f, 1.f - u1)) });
+}
+
+static float PdfCosineHemisphere(const Vector3& n, const Vector3& l)
+{
+    return Vector3::PositiveDot(n, l) / PI;
+}
+
+/**
+ * \brief Samples a half vector proportional to D(h) * cos(theta_h) of NormalDistribution_GGX
+ * \param n Surface normal
+ * \param roughness Roughness of the material, squared the same way as NormalDistribution_GGX
+ * \param u1 Uniform random number in [0, 1)
+ * \param u2 Uniform random number in [0, 1)
+ * \return Normalized half vector
+ */
+static Vector3 SampleHalfVector_GGX(const Vector3& n, float roughness, float u1, float u2)
+{
+    const float alphaSquared{ std::pow(roughness, 4.f) };
+    const float cosTheta{ std::sqrt((1.f - u1) / ((u1 * (alphaSquared - 1.f)) + 1.f)) };
+    const float sinTheta{ std::sqrt(std::max(0.f, 1.f - (cosTheta * cosTheta))) };
+    const float phi{ PI_2 * u2 };
+    return LocalToWorld(n, { sinTheta * std::cos(phi), sinTheta * std::sin(phi), cosTheta });
+}
+
+/**
+ * \brief Pdf of the light direction l when its half vector was drawn with SampleHalfVector_GGX
+ * \param n Surface normal
+ * \param v Normalized view direction
+ * \param l Normalized light direction (reflection of v about the half vector)
+ * \param roughness Roughness of the material
+ */
+static float PdfReflection_GGX(const Vector3& n, const Vector3& v, const Vector3& l, float roughness)
+{
+    const Vector3 h{ (v + l).Normalized() };
+    const float vh{ Vector3::PositiveDot(v, h) };
+    if(vh <= 0.f)
+        return 0.f;
+
+    return NormalDistribution_GGX(n, h, roughness) * Vector3::PositiveDot(n, h) / (4.f * vh);
+}
+
 }  // namespace dae::BRDF
@@ -1,12 +1,16 @@
 #pragma once
 #include <algorithm>
+#include <cassert>
+#include <cmath>
 #include <complex>
 #include <cstdint>
+#include <filesystem>
 #include <vector>
 
 #include "ColorRGB.hpp"
 #include "Matrix.hpp"
 #include "Vector3.hpp"
+#include "WideBVH.hpp"
 
 namespace dae
 {
@@ -20,6 +24,65 @@ struct Sphere final
     unsigned char materialIndex{ 0 };
 };
 
+/**
+ * \brief Structure-of-arrays copy of the scene's spheres for the batched kernels. Arrays are padded to a multiple of
+ * BATCH_SIZE with spheres that can never be hit, so kernels never need a scalar tail.
+ */
+struct SphereSoA final
+{
+    static constexpr size_t BATCH_SIZE{ 8 };
+
+    std::vector<float> originX;
+    std::vector<float> originY;
+    std::vector<float> originZ;
+    std::vector<float> radiusSquared;
+    std::vector<unsigned char> materialIndices;
+    size_t count{};
+
+    void Add(const Sphere& sphere)
+    {
+        if(count == originX.size())
+        {
+            const size_t paddedSize{ originX.size() + BATCH_SIZE };
+            originX.resize(paddedSize, 0.f);
+            originY.resize(paddedSize, 0.f);
+            originZ.resize(paddedSize, 0.f);
+            radiusSquared.resize(paddedSize, -1.f);  // Negative radius fails every discriminant test
+            materialIndices.resize(paddedSize, 0);
+        }
+
+        ++count;
+        Set(count - 1, sphere);
+    }
+
+    void Set(size_t sphereIdx, const Sphere& sphere)
+    {
+        originX[sphereIdx] = sphere.origin.x;
+        originY[sphereIdx] = sphere.origin.y;
+        originZ[sphereIdx] = sphere.origin.z;
+        radiusSquared[sphereIdx] = sphere.radius * sphere.radius;
+        materialIndices[sphereIdx] = sphere.materialIndex;
+    }
+
+    void Rebuild(const std::vector<Sphere>& spheres)
+    {
+        originX.clear();
+        originY.clear();
+        originZ.clear();
+        radiusSquared.clear();
+        materialIndices.clear();
+        count = 0;
+
+        for(const Sphere& sphere : spheres)
+            Add(sphere);
+    }
+
+    [[nodiscard]] size_t GetPaddedSize() const
+    {
+        return originX.size();
+    }
+};
+
 struct Plane final
 {
     Vector3 origin;
@@ -70,6 +133,143 @@ struct Triangle final
     unsigned char materialIndex{};
 };
 
+/**
+ * \brief Intersection-ready triangle, rebuilt whenever the owning mesh's transforms change so the ray loop only loads
+ * and tests. Barycentrics come from the plane hit point projected along the dominant normal axis, folded into two
+ * vectors (zero on the dropped axis) so no per-ray axis selection is needed.
+ */
+struct TriangleRecord final
+{
+    Vector3 normal;  // Normalized, zero for degenerate triangles so they never pass the parallel test
+    float planeD{};  // Dot(normal, v0)
+
+    Vector3 v0;
+    Vector3 betaAxis;   // Dot(hitPoint - v0, betaAxis) -> weight of v1
+    Vector3 gammaAxis;  // Dot(hitPoint - v0, gammaAxis) -> weight of v2
+
+    TriangleRecord() = default;
+
+    TriangleRecord(const Vector3& _v0, const Vector3& _v1, const Vector3& _v2, const Vector3& _normal)
+        : normal{ _normal.Normalized() }
+        , v0{ _v0 }
+    {
+        const Vector3 edgeV0V1{ _v1 - _v0 };
+        const Vector3 edgeV0V2{ _v2 - _v0 };
+        const Vector3 geometricNormal{ Vector3::Cross(edgeV0V1, edgeV0V2) };
+
+        // Project onto the plane spanned by the two axes the normal is least aligned with
+        const Vector3 absNormal{ std::abs(geometricNormal.x), std::abs(geometricNormal.y), std::abs(geometricNormal.z) };
+        const int k{ absNormal.x > absNormal.y ? (absNormal.x > absNormal.z ? 0 : 2) : (absNormal.y > absNormal.z ? 1 : 2) };
+        const int u{ (k + 1) % 3 };
+        const int v{ (k + 2) % 3 };
+
+        const float determinant{ (edgeV0V1[u] * edgeV0V2[v]) - (edgeV0V1[v] * edgeV0V2[u]) };
+        if(determinant == 0.f)
+        {
+            normal = Vector3::Zero;
+            return;
+        }
+
+        planeD = Vector3::Dot(normal, v0);
+        betaAxis[u] = edgeV0V2[v] / determinant;
+        betaAxis[v] = -edgeV0V2[u] / determinant;
+        gammaAxis[u] = -edgeV0V1[v] / determinant;
+        gammaAxis[v] = edgeV0V1[u] / determinant;
+    }
+};
+
+/**
+ * \brief Structure-of-arrays vertex positions or normals of a mesh for the batched transform kernels. Arrays are padded
+ * to a multiple of BATCH_SIZE so kernels never need a scalar tail, resizing to the same count keeps the storage.
+ */
+struct VertexStream final
+{
+    static constexpr size_t BATCH_SIZE{ 8 };
+
+    std::vector<float> x;
+    std::vector<float> y;
+    std::vector<float> z;
+    size_t count{};
+
+    void Resize(size_t newCount)
+    {
+        const size_t paddedSize{ ((newCount + BATCH_SIZE - 1) / BATCH_SIZE) * BATCH_SIZE };
+        x.resize(paddedSize, 0.f);
+        y.resize(paddedSize, 0.f);
+        z.resize(paddedSize, 0.f);
+        count = newCount;
+    }
+
+    void Set(size_t idx, const Vector3& v)
+    {
+        x[idx] = v.x;
+        y[idx] = v.y;
+        z[idx] = v.z;
+    }
+
+    [[nodiscard]] Vector3 Get(size_t idx) const
+    {
+        return { x[idx], y[idx], z[idx] };
+    }
+
+    [[nodiscard]] size_t GetPaddedSize() const
+    {
+        return x.size();
+    }
+};
+
+/**
+ * \brief Compact object space data of a mesh, see TriangleMesh::Compact. Positions are 16 bits per axis relative to the
+ * object AABB, normals are octahedral encoded into two 16-bit snorm values and indices drop to 16 bits when every
+ * vertex fits.
+ */
+struct CompactMeshStorage final
+{
+    // Padded to VertexStream::BATCH_SIZE like the float streams, empty when positions stay full precision
+    std::vector<uint16_t> positionX;
+    std::vector<uint16_t> positionY;
+    std::vector<uint16_t> positionZ;
+    Vector3 positionScale;  // Object AABB extent per quantization step
+
+    std::vector<uint32_t> normals;
+    std::vector<uint16_t> indices;  // Empty when the mesh needs 32-bit indices
+    size_t vertexCount{};
+
+    [[nodiscard]] bool HasQuantizedPositions() const
+    {
+        return not positionX.empty();
+    }
+
+    [[nodiscard]] static uint32_t EncodeNormal(const Vector3& normal)
+    {
+        // Project onto the octahedron, then fold the lower half over the diagonals
+        const float l1Norm{ std::abs(normal.x) + std::abs(normal.y) + std::abs(normal.z) };
+        float u{ l1Norm > 0.f ? normal.x / l1Norm : 0.f };
+        float v{ l1Norm > 0.f ? normal.y / l1Norm : 0.f };
+        if(normal.z < 0.f)
+        {
+            const float foldedU{ (1.f - std::abs(v)) * (u >= 0.f ? 1.f : -1.f) };
+            v = (1.f - std::abs(u)) * (v >= 0.f ? 1.f : -1.f);
+            u = foldedU;
+        }
+
+        const auto toSnorm16 = [](float value)
+        { return static_cast<uint16_t>(static_cast<int16_t>(std::lround(std::clamp(value, -1.f, 1.f) * 32767.f))); };
+        return static_cast<uint32_t>(toSnorm16(u)) | (static_cast<uint32_t>(toSnorm16(v)) << 16);
+    }
+
+    [[nodiscard]] static Vector3 DecodeNormal(uint32_t encoded)
+    {
+        float u{ static_cast<float>(static_cast<int16_t>(encoded & 0xFFFF)) / 32767.f };
+        float v{ static_cast<float>(static_cast<int16_t>(encoded >> 16)) / 32767.f };
+        const float z{ 1.f - std::abs(u) - std::abs(v) };
+        const float unfold{ std::max(-z, 0.f) };
+        u += u >= 0.f ? -unfold : unfold;
+        v += v >= 0.f ? -unfold : unfold;
+        return Vector3{ u, v, z }.Normalized();
+    }
+};
+
 struct TriangleMesh final
 {
     TriangleMesh() = default;
@@ -103,13 +303,40 @@ struct TriangleMesh final
 
     TriangleCullMode cullMode{ TriangleCullMode::BackFaceCulling };
 
+    // Use the watertight test for closed meshes, rays can't slip through shared edges
+    bool isWatertight{ false };
+
     Matrix rotationTransform;
     Matrix translationTransform;
     Matrix scaleTransform;
 
-    std::vector<Vector3> transformedVertices;
-    std::vector<Vector3> transformedNormals;
+    // Object space copies of vertices and normals, refreshed when the geometry changes
+    VertexStream objectVertices;
+    VertexStream objectNormals;
+
+    // Written in place every transform update, the storage only grows when the vertex count does
+    VertexStream transformedVertices;
+    VertexStream transformedNormals;
+    std::vector<TriangleRecord> triangleRecords;
+
+    // Chunk indices for the parallel transform passes
+    std::vector<uint32_t> transformChunkIndices;
+
+    // World space BVH over the triangle records. SAH trees are rebuilt when the geometry changes and refit when only the
+    // transform does, Linear trees are rebuilt on every update
+    WideBVH bvh;
+    WideBVH::BuildMethod bvhBuildMethod{ WideBVH::BuildMethod::SAH };
 
+    // When set, SAH builds go through a cache of built trees in this directory, see WideBVH::BuildCached. Meant for
+    // large meshes with static geometry, whose startup then maps the tree from disk instead of building it. The key is
+    // taken from the world space triangle boxes, so the mesh has to start from the same transform to hit.
+    std::filesystem::path bvhCacheDirectory;
+    std::vector<WideBVH::Bounds> triangleBounds;
+    bool isBVHDirty{ true };
+
+    // Set by Compact(), vertices, normals, indices and the float object streams are then released
+    bool isCompact{ false };
+    CompactMeshStorage compactStorage;
 
     Vector3 minObjectAABB;
     Vector3 maxObjectAABB;
@@ -117,19 +344,67 @@ struct TriangleMesh final
     Vector3 minWorldAABB;
     Vector3 maxWorldAABB;
 
+    // Set whenever the transform or the vertices changed, Update() only recomputes what they invalidate
+    bool isTransformDirty{ true };
+    bool isGeometryDirty{ true };
+
     void Translate(const Vector3& translation)
     {
-        translationTransform = Matrix::CreateTranslation(translation);
+        SetTransform(translationTransform, Matrix::CreateTranslation(translation));
     }
 
     void RotateY(float yaw)
     {
-        rotationTransform = Matrix::CreateRotationY(yaw);
+        SetTransform(rotationTransform, Matrix::CreateRotationY(yaw));
     }
 
     void Scale(const Vector3& scale)
     {
-        scaleTransform = Matrix::CreateScale(scale);
+        SetTransform(scaleTransform, Matrix::CreateScale(scale));
+    }
+
+    // Call after editing vertices, normals or indices directly
+    void MarkGeometryDirty()
+    {
+        assert(not isCompact && "Compact meshes released their source geometry and can't be edited");
+        isGeometryDirty = true;
+    }
+
+    // Recomputes the object AABB and the transformed data only when dirty, returns whether anything changed
+    bool Update()
+    {
+        // Compact geometry never changes, a stray dirty flag must not re-transform the mesh every frame
+        if(isCompact)
+            isGeometryDirty = false;
+
+        if(not isGeometryDirty and not isTransformDirty)
+            return false;
+
+        if(isGeometryDirty)
+        {
+            UpdateVertexStreams();
+            UpdateAABB();
+        }
+
+        UpdateTransforms();
+        return true;
+    }
+
+    /**
+     * \brief Converts the mesh to compact storage: octahedral 32-bit normals, 16-bit indices when the vertex count
+     * allows and, with quantizePositions, 16-bit positions inside the object AABB. The float source data is released,
+     * so the geometry can no longer be edited afterwards, only transformed. The transform kernels decode on the fly.
+     */
+    void Compact(bool quantizePositions);
+
+    [[nodiscard]] size_t GetVertexCount() const
+    {
+        return isCompact ? compactStorage.vertexCount : vertices.size();
+    }
+
+    [[nodiscard]] int GetIndex(size_t idx) const
+    {
+        return compactStorage.indices.empty() ? indices[idx] : compactStorage.indices[idx];
     }
 
     void AppendTriangle(const Triangle& triangle, bool ignoreTransformUpdate = false)
@@ -145,6 +420,7 @@ struct TriangleMesh final
         indices.push_back(++startIndex);
 
         normals.push_back(triangle.normal);
+        isGeometryDirty = true;
 
         // Not ideal, but making sure all vertices are updated
         if(!ignoreTransformUpdate)
@@ -163,33 +439,17 @@ struct TriangleMesh final
             const Vector3 vectorB{ vert1, vert2 };
             normals.push_back((Vector3::Cross(vectorA, vectorB)).Normalized());
         }
+        isGeometryDirty = true;
     }
 
-    void UpdateTransforms()
-    {
-        if(transformedVertices.size() < vertices.size() or transformedNormals.size() < normals.size())
-        {
-            transformedVertices.resize(vertices.size());
-            transformedNormals.resize(normals.size());
-        }
-
-        Matrix finalTransform = scaleTransform * rotationTransform * translationTransform;
-
-        transformedVertices.clear();
-        transformedNormals.clear();
-
-        for(auto const& vertex : vertices)
-        {
-            transformedVertices.emplace_back(finalTransform.TransformPoint(vertex));
-        }
-
-        for(auto const& normal : normals)
-        {
-            transformedNormals.emplace_back(rotationTransform.TransformPoint(normal));
-        }
-
-        UpdateTransformedAABB(finalTransform);
-    }
+    /**
+     * \brief Transforms the object space streams into the transformed streams and rebuilds the triangle records. Large
+     * meshes are split into chunks processed in parallel, each chunk runs the AVX2 matrix kernel.
+     */
+    void UpdateTransforms();
+    void UpdateTriangleRecords();
+    void UpdateVertexStreams();
+    void UpdateBVH();
 
     void UpdateAABB()
     {
@@ -203,43 +463,22 @@ struct TriangleMesh final
                 maxObjectAABB = Vector3::Max(vertex, maxObjectAABB);
             }
         }
-    }
 
-    void UpdateTransformedAABB(const Matrix& finalTransform)
-    {
-        Vector3 tMinAABB = finalTransform.TransformPoint(minObjectAABB);
-        Vector3 tMaxAABB = tMinAABB;
-
-        Vector3 tAABB = finalTransform.TransformPoint(maxObjectAABB.x, minObjectAABB.y, minObjectAABB.z);
-        tMinAABB = Vector3::Min(tAABB, tMinAABB);
-        tMaxAABB = Vector3::Max(tAABB, tMaxAABB);
-
-        tAABB = finalTransform.TransformPoint(maxObjectAABB.x, minObjectAABB.y, maxObjectAABB.z);
-        tMinAABB = Vector3::Min(tAABB, tMinAABB);
-        tMaxAABB = Vector3::Max(tAABB, tMaxAABB);
-
-        tAABB = finalTransform.TransformPoint(minObjectAABB.x, minObjectAABB.y, maxObjectAABB.z);
-        tMinAABB = Vector3::Min(tAABB, tMinAABB);
-        tMaxAABB = Vector3::Max(tAABB, tMaxAABB);
-
-        tAABB = finalTransform.TransformPoint(minObjectAABB.x, maxObjectAABB.y, minObjectAABB.z);
-        tMinAABB = Vector3::Min(tAABB, tMinAABB);
-        tMaxAABB = Vector3::Max(tAABB, tMaxAABB);
-
-        tAABB = finalTransform.TransformPoint(maxObjectAABB.x, maxObjectAABB.y, minObjectAABB.z);
-        tMinAABB = Vector3::Min(tAABB, tMinAABB);
-        tMaxAABB = Vector3::Max(tAABB, tMaxAABB);
+        // The world AABB derives from the object AABB
+        isGeometryDirty = false;
+        isTransformDirty = true;
+    }
 
-        tAABB = finalTransform.TransformPoint(maxObjectAABB.x, maxObjectAABB.y, maxObjectAABB.z);
-        tMinAABB = Vector3::Min(tAABB, tMinAABB);
-        tMaxAABB = Vector3::Max(tAABB, tMaxAABB);
+    void UpdateTransformedAABB(const Matrix& finalTransform);
 
-        tAABB = finalTransform.TransformPoint(minObjectAABB.x, maxObjectAABB.y, maxObjectAABB.z);
-        tMinAABB = Vector3::Min(tAABB, tMinAABB);
-        tMaxAABB = Vector3::Max(tAABB, tMaxAABB);
+private:
+    void SetTransform(Matrix& transform, const Matrix& newTransform)
+    {
+        if(transform == newTransform)
+            return;
 
-        minWorldAABB = tMinAABB;
-        maxWorldAABB = tMaxAABB;
+        transform = newTransform;
+        isTransformDirty = true;
     }
 };
 
@@ -248,7 +487,10 @@ struct TriangleMesh final
 enum class LightType : uint8_t
 {
     Point,
-    Directional
+    Directional,
+    Rectangle,  // One sided, emits along direction
+    Disk,       // One sided, emits along direction
+    Sphere
 };
 
 struct Light final
@@ -258,6 +500,11 @@ struct Light final
     ColorRGB color{};
     float intensity{};
 
+    // Area lights: half extents of a rectangle or the in-plane radius axes of a disk
+    Vector3 axisU;
+    Vector3 axisV;
+    float radius{};  // Disk and sphere
+
     LightType type{};
 };
 
@@ -283,5 +530,22 @@ struct HitRecord final
     unsigned char materialIndex{ 0 };
 };
 
+enum class OccluderType : uint8_t
+{
+    None,
+    SphereBatch,  // BATCH_SIZE spheres of the SoA store, index is the first sphere
+    Spheres,      // Every sphere through the scene's sphere acceleration structure
+    Plane,
+    Triangle,
+    TriangleMesh
+};
+
+// Handle to the geometry that last blocked a shadow ray, tested first by the next query towards the same light
+struct OccluderReference final
+{
+    OccluderType type{ OccluderType::None };
+    uint32_t index{};
+};
+
 #pragma endregion
 }  // namespace dae
@@ -0,0 +1,100 @@
+#pragma once
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <span>
+#include <type_traits>
+#include <vector>
+
+namespace dae
+{
+/**
+ * \brief Per-thread bump allocator for transient render data. Allocating is a pointer bump in the calling thread's own
+ * arena, BeginFrame() releases every thread's allocations at once in O(1) by advancing a frame counter, each arena
+ * rewinds the first time its thread uses it in the new frame. Blocks are kept across frames, so once the first frames
+ * grew them rendering no longer touches the heap.
+ */
+class FrameArena final
+{
+public:
+    FrameArena() = default;
+    ~FrameArena() = default;
+
+    FrameArena(const FrameArena&) = delete;
+    FrameArena(FrameArena&&) noexcept = delete;
+    FrameArena& operator=(const FrameArena&) = delete;
+    FrameArena& operator=(FrameArena&&) noexcept = delete;
+
+    // Arena of the calling thread, rewound when a frame started since its last use
+    [[nodiscard]] static FrameArena& GetThreadArena();
+
+    // Invalidates everything allocated from any thread's arena during the previous frame
+    static void BeginFrame()
+    {
+        s_FrameIdx.fetch_add(1, std::memory_order_relaxed);
+    }
+
+    [[nodiscard]] void* Allocate(size_t size, size_t alignment);
+
+    // Default constructed array, only for types that need no destructor since the arena never runs one
+    template<typename T>
+    [[nodiscard]] std::span<T> AllocateArray(size_t count)
+    {
+        static_assert(std::is_trivially_destructible_v<T>);
+        T* const pData{ static_cast<T*>(Allocate(count * sizeof(T), alignof(T))) };
+        std::uninitialized_default_construct_n(pData, count);
+        return { pData, count };
+    }
+
+    // Rewinds the arena to where it was on construction, for scratch that only lives during a loop iteration
+    class Scope final
+    {
+    public:
+        explicit Scope(FrameArena& arena)
+            : m_Arena{ arena }
+            , m_BlockIdx{ arena.m_BlockIdx }
+            , m_Offset{ arena.m_Offset }
+        {
+        }
+
+        ~Scope()
+        {
+            m_Arena.m_BlockIdx = m_BlockIdx;
+            m_Arena.m_Offset = m_Offset;
+        }
+
+        Scope(const Scope&) = delete;
+        Scope(Scope&&) noexcept = delete;
+        Scope& operator=(const Scope&) = delete;
+        Scope& operator=(Scope&&) noexcept = delete;
+
+    private:
+        FrameArena& m_Arena;
+        size_t m_BlockIdx;
+        size_t m_Offset;
+    };
+
+private:
+    static constexpr size_t DEFAULT_BLOCK_SIZE{ size_t{ 1 } << 20 };
+
+    struct Block final
+    {
+        std::unique_ptr<std::byte[]> pData;
+        size_t size{};
+    };
+
+    void Rewind()
+    {
+        m_BlockIdx = 0;
+        m_Offset = 0;
+    }
+
+    std::vector<Block> m_Blocks;
+    size_t m_BlockIdx{};
+    size_t m_Offset{};
+    uint64_t m_FrameIdx{};
+
+    inline static std::atomic<uint64_t> s_FrameIdx{};
+};
+}  // namespace dae
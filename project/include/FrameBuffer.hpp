@@ -0,0 +1,137 @@
+#pragma once
+#include <cstdint>
+#include <vector>
+
+#include "ColorRGB.hpp"
+
+struct SDL_Surface;
+
+namespace dae
+{
+/**
+ * \brief Float HDR framebuffer the render kernels write into. Resolve() is the post-process stage that maps it to the
+ * window surface in one parallel pass over whole rows: tone mapping, transfer function, optional ordered dithering and
+ * packing into the surface's pixel layout, 8 pixels at a time with AVX2.
+ */
+class FrameBuffer final
+{
+public:
+    FrameBuffer() = default;
+    FrameBuffer(int width, int height);
+    ~FrameBuffer() = default;
+
+    FrameBuffer(const FrameBuffer&) = delete;
+    FrameBuffer(FrameBuffer&&) noexcept = delete;
+    FrameBuffer& operator=(const FrameBuffer&) = delete;
+    FrameBuffer& operator=(FrameBuffer&&) noexcept = delete;
+
+    enum class ToneMappingOperator : uint8_t
+    {
+        MaxToOne,  // Divide by the largest channel when it exceeds one
+        Exposure,  // Scale by exposure and clamp
+        Reinhard,  // c / (1 + c)
+        ACES,      // Narkowicz ACES filmic fit
+        Count
+    };
+
+    enum class TransferFunction : uint8_t
+    {
+        Linear,
+        Gamma,  // Pure power curve with the gamma set through SetGamma
+        SRGB
+    };
+
+    void SetPixel(int pixelIdx, const ColorRGB& color)
+    {
+        m_Red[pixelIdx] = color.r;
+        m_Green[pixelIdx] = color.g;
+        m_Blue[pixelIdx] = color.b;
+    }
+
+    [[nodiscard]] ColorRGB GetPixel(int pixelIdx) const
+    {
+        return { .r = m_Red[pixelIdx], .g = m_Green[pixelIdx], .b = m_Blue[pixelIdx] };
+    }
+
+    // Tone maps, encodes and packs every pixel into the surface
+    void Resolve(SDL_Surface* pSurface) const;
+
+    void SetToneMappingOperator(ToneMappingOperator toneMappingOperator)
+    {
+        m_ToneMappingOperator = toneMappingOperator;
+    }
+
+    [[nodiscard]] ToneMappingOperator GetToneMappingOperator() const
+    {
+        return m_ToneMappingOperator;
+    }
+
+    // Linear scale applied before every operator except MaxToOne
+    void SetExposure(float exposure)
+    {
+        m_Exposure = exposure;
+    }
+
+    void SetTransferFunction(TransferFunction transferFunction);
+    void SetGamma(float gamma);
+
+    [[nodiscard]] TransferFunction GetTransferFunction() const
+    {
+        return m_TransferFunction;
+    }
+
+    void SetDitheringEnabled(bool isEnabled)
+    {
+        m_DitheringEnabled = isEnabled;
+    }
+
+    [[nodiscard]] bool IsDitheringEnabled() const
+    {
+        return m_DitheringEnabled;
+    }
+
+private:
+    static constexpr int TRANSFER_LUT_SIZE{ 4096 };
+
+    struct PixelPacking final
+    {
+        uint32_t rShift{};
+        uint32_t gShift{};
+        uint32_t bShift{};
+        uint32_t alphaMask{};
+    };
+
+    // Specialized per operator so the row loop carries no per-pixel switch
+    template<ToneMappingOperator toneMappingOperator>
+    void ResolveRows(SDL_Surface* pSurface) const;
+    template<ToneMappingOperator toneMappingOperator>
+    void ResolveRow(int row, uint32_t* pRow, const PixelPacking& packing) const;
+    template<ToneMappingOperator toneMappingOperator>
+    void ResolveRowMapped(int row, uint8_t* pRow, const SDL_Surface* pSurface) const;
+    template<ToneMappingOperator toneMappingOperator>
+    [[nodiscard]] ColorRGB ToneMap(const ColorRGB& color) const;
+
+    // Encodes a tone mapped [0, 1] value to 8 bits, ditherOffset is in 1/256th of an 8-bit step
+    [[nodiscard]] uint32_t EncodeChannel(float value, uint32_t ditherOffset) const;
+    [[nodiscard]] uint32_t GetDitherOffset(int px, int row) const;
+    void BuildTransferLUT();
+
+    int m_Width{};
+    int m_Height{};
+    std::vector<int> m_RowIndices;
+
+    // Stored as separate channels so a row loads straight into SIMD registers
+    std::vector<float> m_Red;
+    std::vector<float> m_Green;
+    std::vector<float> m_Blue;
+
+    ToneMappingOperator m_ToneMappingOperator{ ToneMappingOperator::MaxToOne };
+    TransferFunction m_TransferFunction{ TransferFunction::Linear };
+    float m_Exposure{ 1.f };
+    float m_Gamma{ 2.2f };
+    bool m_DitheringEnabled{ false };
+
+    // [0, 1] quantized to TRANSFER_LUT_SIZE steps -> encoded value in 8.8 fixed point
+    std::vector<int32_t> m_TransferLUT;
+};
+}  // namespace dae
@@ -20,6 +20,8 @@
     #define free(p) _free_dbg(p, _NORMAL_BLOCK)
 #endif
 
+#include <iosfwd>
+
 namespace dae
 {
     //--- Class ----
@@ -37,6 +39,34 @@ namespace dae
         //--- Functions ---
         static void BreakOnAllocationId(const int id);
         static void CheckForLeaks();
+
+        //--- Allocation Profiling ---
+        // Counts operator new calls and bytes per frame and per tag, in any build configuration.
+        // Needs ALLOCATION_PROFILER_ENABLED, every function below is a no-op without it.
+        class AllocationTag final
+        {
+        public:
+            // Attributes allocations from every thread to name until destroyed, name has to stay valid (a literal)
+            explicit AllocationTag(const char* name);
+            ~AllocationTag();
+            AllocationTag(const AllocationTag&) = delete;
+            AllocationTag& operator=(const AllocationTag&) = delete;
+            AllocationTag(AllocationTag&&) = delete;
+            AllocationTag& operator=(AllocationTag&&) = delete;
+
+        private:
+            int m_PreviousTagId{};
+        };
+
+        static void BeginFrame();
+        static void EndFrame();
+
+        // Allocations and bytes since the previous report, in total and per tag
+        static void PrintAllocationReport(std::ostream& os);
+
+        // Aborts with a report once a frame after the first warmupFrames allocates, for CI runs of the render loop.
+        // Returns false when the profiler is not built in, the assertion could then never fire.
+        static bool EnableAllocationAssertion(int warmupFrames);
     };
 }
 #endif //LEAK_DETECTOR_HEADER
\ No newline at end of file
@@ -0,0 +1,75 @@
+#pragma once
+#include <cstdint>
+#include <span>
+#include <vector>
+
+#include "DataTypes.hpp"
+#include "Vector3.hpp"
+
+namespace dae
+{
+/**
+ * \brief Uniform grid over the influence spheres of the point lights. A point light only reaches the cells its sphere
+ * overlaps, so a hit only iterates the lights listed in its cell plus the unbounded (directional) ones. The radius of a
+ * sphere is where the inverse square falloff drops below the contribution threshold.
+ */
+class LightGrid final
+{
+public:
+    LightGrid() = default;
+    ~LightGrid() = default;
+
+    LightGrid(const LightGrid&) = delete;
+    LightGrid(LightGrid&&) noexcept = delete;
+    LightGrid& operator=(const LightGrid&) = delete;
+    LightGrid& operator=(LightGrid&&) noexcept = delete;
+
+    // Roughly one 8-bit step of a unit exposure output
+    static constexpr float DEFAULT_THRESHOLD{ 1.f / 255.f };
+
+    void Build(const std::vector<Light>& lights, float threshold);
+
+    // Bounded lights whose influence sphere overlaps the cell containing position
+    [[nodiscard]] std::span<const uint32_t> GetLights(const Vector3& position) const;
+
+    // Lights that reach everywhere, directional ones or everything when the threshold is zero
+    [[nodiscard]] const std::vector<uint32_t>& GetUnboundedLights() const
+    {
+        return m_UnboundedLights;
+    }
+
+    [[nodiscard]] bool IsInRange(uint32_t lightIdx, const Vector3& position) const;
+
+    [[nodiscard]] size_t GetBuiltLightCount() const
+    {
+        return m_InfluenceRadiiSquared.size();
+    }
+
+    [[nodiscard]] float GetThreshold() const
+    {
+        return m_Threshold;
+    }
+
+private:
+    static constexpr int MAX_CELLS_PER_AXIS{ 16 };
+
+    [[nodiscard]] int GetCellIndex(int x, int y, int z) const
+    {
+        return x + (m_CellCount[0] * (y + (m_CellCount[1] * z)));
+    }
+
+    float m_Threshold{ DEFAULT_THRESHOLD };
+
+    Vector3 m_BoundsMin;
+    Vector3 m_CellSize;
+    int m_CellCount[3]{};
+
+    // Light lists of all cells back to back, cell i owns [m_CellOffsets[i], m_CellOffsets[i + 1])
+    std::vector<uint32_t> m_CellOffsets;
+    std::vector<uint32_t> m_CellLights;
+
+    std::vector<uint32_t> m_UnboundedLights;
+    std::vector<Vector3> m_LightOrigins;
+    std::vector<float> m_InfluenceRadiiSquared;  // FLT_MAX for unbounded lights
+};
+}  // namespace dae
@@ -0,0 +1,81 @@
+#pragma once
+#include <cstdint>
+#include <vector>
+
+#include "DataTypes.hpp"
+#include "Vector3.hpp"
+
+namespace dae
+{
+/**
+ * \brief Binary hierarchy over the point and area lights with the bounds and total power per node. Sampling walks from
+ * the root and picks a child proportional to its estimated contribution at the shading point, so picking one light
+ * costs O(log n) and lights that barely contribute are rarely shadow tested. Directional lights have no position to
+ * bound and are kept aside for the caller to evaluate every time.
+ */
+class LightTree final
+{
+public:
+    LightTree() = default;
+    ~LightTree() = default;
+
+    LightTree(const LightTree&) = delete;
+    LightTree(LightTree&&) noexcept = delete;
+    LightTree& operator=(const LightTree&) = delete;
+    LightTree& operator=(LightTree&&) noexcept = delete;
+
+    struct LightSample final
+    {
+        uint32_t lightIndex{};
+        float pdf{};  // Probability of this light having been picked
+    };
+
+    void Build(const std::vector<Light>& lights);
+
+    /**
+     * \brief Picks one point light proportional to its estimated contribution
+     * \param origin Shading point
+     * \param normal Surface normal, subtrees fully below the surface are never picked
+     * \param u Uniform random number in [0, 1), rescaled and reused at every level
+     * \param sample Picked light and its probability
+     * \return False when no light can contribute
+     */
+    bool Sample(const Vector3& origin, const Vector3& normal, float u, LightSample& sample) const;
+
+    // Number of lights the tree was built from, directional ones included
+    [[nodiscard]] size_t GetBuiltLightCount() const
+    {
+        return m_BuiltLightCount;
+    }
+
+    [[nodiscard]] bool HasPointLights() const
+    {
+        return not m_Nodes.empty();
+    }
+
+    [[nodiscard]] const std::vector<uint32_t>& GetDirectionalLights() const
+    {
+        return m_DirectionalLights;
+    }
+
+private:
+    struct Node final
+    {
+        Vector3 boundsMin;
+        Vector3 boundsMax;
+        float power{};
+
+        uint32_t leftChild{};
+        uint32_t rightChild{};
+        uint32_t lightIndex{};  // Only valid for leaves
+        bool isLeaf{ false };
+    };
+
+    uint32_t BuildNode(const std::vector<Light>& lights, std::vector<uint32_t>& lightIndices, size_t begin, size_t end);
+    [[nodiscard]] float GetImportance(const Node& node, const Vector3& origin, const Vector3& normal) const;
+
+    std::vector<Node> m_Nodes;
+    std::vector<uint32_t> m_DirectionalLights;
+    size_t m_BuiltLightCount{};
+};
+}  // namespace dae
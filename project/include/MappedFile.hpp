@@ -0,0 +1,42 @@
+#pragma once
+#include <cstddef>
+#include <filesystem>
+#include <span>
+
+namespace dae
+{
+/**
+ * \brief Read-only memory mapping of a whole file. Pages are read in by the OS on first access, the mapping is released
+ * on destruction. A file that is missing, empty or fails to map leaves the object invalid.
+ */
+class MappedFile final
+{
+public:
+    explicit MappedFile(const std::filesystem::path& path);
+    ~MappedFile();
+
+    MappedFile(const MappedFile&) = delete;
+    MappedFile(MappedFile&&) noexcept = delete;
+    MappedFile& operator=(const MappedFile&) = delete;
+    MappedFile& operator=(MappedFile&&) noexcept = delete;
+
+    [[nodiscard]] bool IsValid() const
+    {
+        return m_pData != nullptr;
+    }
+
+    [[nodiscard]] std::span<const std::byte> GetData() const
+    {
+        return { m_pData, m_Size };
+    }
+
+private:
+    const std::byte* m_pData{};
+    size_t m_Size{};
+
+#if defined(_WIN32) || defined(_WIN64)
+    void* m_FileHandle{};
+    void* m_MappingHandle{};
+#endif
+};
+}  // namespace dae
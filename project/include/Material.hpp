@@ -9,6 +9,14 @@ namespace dae
 {
 #pragma region Material BASE
 
+// Direction sampled from a material and its throughput weight f * cos(theta) / pdf
+struct MaterialSample final
+{
+    Vector3 direction;
+    ColorRGB weight;
+    bool isValid{ false };
+};
+
 class Material
 {
 public:
@@ -29,6 +37,24 @@ public:
      * \return color
      */
     virtual ColorRGB Shade(const HitRecord& hitRecord = {}, const Vector3& l = {}, const Vector3& v = {}) = 0;
+
+    /**
+     * \brief Importance samples an incoming direction for path tracing, cosine weighted by default
+     * \param hitRecord current hitrecord
+     * \param v view direction
+     * \param u1 uniform random number in [0, 1)
+     * \param u2 uniform random number in [0, 1)
+     * \return sampled direction and its weight
+     */
+    virtual MaterialSample Sample(const HitRecord& hitRecord, const Vector3& v, float u1, float u2)
+    {
+        const Vector3 l{ BRDF::SampleCosineHemisphere(hitRecord.normal, u1, u2) };
+        const float pdf{ BRDF::PdfCosineHemisphere(hitRecord.normal, l) };
+        if(pdf <= 0.f)
+            return {};
+
+        return { .direction = l, .weight = Shade(hitRecord, l, v) * (Vector3::Dot(hitRecord.normal, l) / pdf), .isValid = true };
+    }
 };
 
 #pragma endregion
@@ -142,6 +168,34 @@ public:
         return lambert + cookTorrence;
     }
 
+    // Mixture of GGX half vector and cosine sampling, the specular lobe is picked more often the more metallic
+    MaterialSample Sample(const HitRecord& hitRecord, const Vector3& v, float u1, float u2) override
+    {
+        const float specularProbability{ Lerpf(0.5f, 1.f, m_Metalness) };
+
+        Vector3 l{};
+        if(u1 < specularProbability)
+        {
+            const Vector3 halfVector{ BRDF::SampleHalfVector_GGX(hitRecord.normal, m_Roughness, u1 / specularProbability, u2) };
+            l = Vector3::Reflect(-v, halfVector);
+        }
+        else
+        {
+            l = BRDF::SampleCosineHemisphere(hitRecord.normal, (u1 - specularProbability) / (1.f - specularProbability), u2);
+        }
+
+        const float cosTheta{ Vector3::Dot(hitRecord.normal, l) };
+        if(cosTheta <= 0.f)
+            return {};
+
+        const float pdf{ (specularProbability * BRDF::PdfReflection_GGX(hitRecord.normal, v, l, m_Roughness)) +
+                         ((1.f - specularProbability) * BRDF::PdfCosineHemisphere(hitRecord.normal, l)) };
+        if(pdf <= 0.f)
+            return {};
+
+        return { .direction = l, .weight = Shade(hitRecord, l, v) * (cosTheta / pdf), .isValid = true };
+    }
+
 private:
     ColorRGB m_Albedo{ .r = 0.955f, .g = 0.637f, .b = 0.538f };  // Copper
     float m_Metalness{ 1.0f };
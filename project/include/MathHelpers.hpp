@@ -1,6 +1,7 @@
 #pragma once
 #include <cfloat>
 #include <cmath>
+#include <cstdint>
 
 namespace dae
 {
@@ -63,4 +64,53 @@ inline float Saturate(const float v)
         return 1.f;
     return v;
 }
+
+// PCG hash, turns neighbouring seeds (pixel and sample indices) into uncorrelated values
+inline uint32_t HashPCG(uint32_t value)
+{
+    const uint32_t state{ (value * 747796405u) + 2891336453u };
+    const uint32_t word{ ((state >> ((state >> 28u) + 4u)) ^ state) * 277803737u };
+    return (word >> 22u) ^ word;
+}
+
+// First dimension of the Sobol sequence (base 2 radical inverse), XOR scrambled
+inline float Sobol0(uint32_t index, uint32_t scramble)
+{
+    uint32_t bits{ index };
+    bits = (bits << 16u) | (bits >> 16u);
+    bits = ((bits & 0x00ff00ffu) << 8u) | ((bits & 0xff00ff00u) >> 8u);
+    bits = ((bits & 0x0f0f0f0fu) << 4u) | ((bits & 0xf0f0f0f0u) >> 4u);
+    bits = ((bits & 0x33333333u) << 2u) | ((bits & 0xccccccccu) >> 2u);
+    bits = ((bits & 0x55555555u) << 1u) | ((bits & 0xaaaaaaaau) >> 1u);
+    return static_cast<float>((bits ^ scramble) >> 8) * (1.f / 16777216.f);
+}
+
+// Second dimension of the Sobol sequence, XOR scrambled. Together with Sobol0 every power of two prefix is stratified
+inline float Sobol1(uint32_t index, uint32_t scramble)
+{
+    uint32_t bits{};
+    for(uint32_t direction{ 1u << 31u }; index != 0; index >>= 1u, direction ^= direction >> 1u)
+    {
+        if(index & 1u)
+            bits ^= direction;
+    }
+    return static_cast<float>((bits ^ scramble) >> 8) * (1.f / 16777216.f);
+}
+
+// Inserts two zero bits above each of the low 10 bits, interleaving three of these gives a Morton code
+inline uint32_t SpreadBits(uint32_t value)
+{
+    value = (value | (value << 16)) & 0x030000FF;
+    value = (value | (value << 8)) & 0x0300F00F;
+    value = (value | (value << 4)) & 0x030C30C3;
+    value = (value | (value << 2)) & 0x09249249;
+    return value;
+}
+
+// Advances the state and returns a uniform float in [0, 1)
+inline float RandomFloat(uint32_t& state)
+{
+    state = HashPCG(state);
+    return static_cast<float>(state >> 8) * (1.f / 16777216.f);
+}
 }  // namespace dae
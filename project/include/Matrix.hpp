@@ -1,4 +1,7 @@
 #pragma once
+#include <cstddef>
+#include <cstdint>
+
 #include "Vector3.hpp"
 #include "Vector4.hpp"
 
@@ -24,6 +27,16 @@ struct Matrix final
     [[nodiscard]] Vector4 TransformPoint(const Vector4& p) const;
     [[nodiscard]] Vector4 TransformPoint(float x, float y, float z, float w) const;
 
+    // Transforms count points or vectors stored as separate x, y and z arrays, 8 per iteration with AVX2.
+    // The output arrays may alias the input arrays.
+    void TransformPoints(const float* pX, const float* pY, const float* pZ, float* pOutX, float* pOutY, float* pOutZ,
+                         size_t count) const;
+    void TransformVectors(const float* pX, const float* pY, const float* pZ, float* pOutX, float* pOutY, float* pOutZ,
+                          size_t count) const;
+    // Quantized input, fold the dequantization scale and offset into the matrix
+    void TransformPoints(const uint16_t* pX, const uint16_t* pY, const uint16_t* pZ, float* pOutX, float* pOutY, float* pOutZ,
+                         size_t count) const;
+
     const Matrix& Transpose();
     const Matrix& Inverse();
 
@@ -52,10 +65,15 @@ struct Matrix final
     Vector4 operator[](int index) const;
     Matrix operator*(const Matrix& m) const;
     const Matrix& operator*=(const Matrix& m);
+    bool operator==(const Matrix& m) const;
 
     void AsColMajArray(float out[4][4]) const;
 
 private:
+    template<bool isPoint, typename InputType>
+    void TransformStreams(const InputType* pX, const InputType* pY, const InputType* pZ, float* pOutX, float* pOutY,
+                          float* pOutZ, size_t count) const;
+
     // Row-Major Matrix
     Vector4 data[4]{
         { 1, 0, 0, 0 },  // xAxis
@@ -0,0 +1,41 @@
+#pragma once
+#include <algorithm>
+#include <cassert>
+#include <cstddef>
+#include <cstdint>
+#include <execution>
+#include <numeric>
+#include <vector>
+
+namespace dae
+{
+/**
+ * \brief Runs function(begin, end) over [0, count) in chunkSize chunks, in parallel once there is more than one.
+ * chunkIndices is the caller's list of chunk indices for std::for_each, it only grows, so repeated calls don't allocate.
+ */
+template<typename Function>
+void ForEachChunk(std::vector<uint32_t>& chunkIndices, size_t count, size_t chunkSize, const Function& function)
+{
+    assert(chunkSize > 0);
+
+    const size_t chunkCount{ (count + chunkSize - 1) / chunkSize };
+    if(chunkCount <= 1)
+    {
+        function(size_t{}, count);
+        return;
+    }
+
+    if(chunkIndices.size() < chunkCount)
+    {
+        chunkIndices.resize(chunkCount);
+        std::iota(chunkIndices.begin(), chunkIndices.end(), 0);
+    }
+
+    std::for_each(std::execution::par, chunkIndices.begin(), chunkIndices.begin() + static_cast<std::ptrdiff_t>(chunkCount),
+                  [count, chunkSize, &function](uint32_t chunkIdx)
+                  {
+                      const size_t begin{ chunkIdx * chunkSize };
+                      function(begin, std::min(begin + chunkSize, count));
+                  });
+}
+}  // namespace dae
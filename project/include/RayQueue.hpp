@@ -0,0 +1,58 @@
+#pragma once
+#include <cstddef>
+#include <vector>
+
+#include "DataTypes.hpp"
+#include "Vector3.hpp"
+
+namespace dae
+{
+/**
+ * \brief Structure of arrays ray buffer for the wavefront integrator. Each stage of the integrator reads and writes
+ * whole queues, so every component lives in its own contiguous array and a stage streams through it linearly.
+ */
+struct RayQueue final
+{
+    std::vector<float> originX;
+    std::vector<float> originY;
+    std::vector<float> originZ;
+    std::vector<float> directionX;
+    std::vector<float> directionY;
+    std::vector<float> directionZ;
+    std::vector<float> tMax;
+
+    void Resize(size_t size)
+    {
+        originX.resize(size);
+        originY.resize(size);
+        originZ.resize(size);
+        directionX.resize(size);
+        directionY.resize(size);
+        directionZ.resize(size);
+        tMax.resize(size);
+    }
+
+    [[nodiscard]] size_t GetSize() const
+    {
+        return originX.size();
+    }
+
+    void Set(size_t slot, const Ray& ray)
+    {
+        originX[slot] = ray.origin.x;
+        originY[slot] = ray.origin.y;
+        originZ[slot] = ray.origin.z;
+        directionX[slot] = ray.direction.x;
+        directionY[slot] = ray.direction.y;
+        directionZ[slot] = ray.direction.z;
+        tMax[slot] = ray.max;
+    }
+
+    [[nodiscard]] Ray Get(size_t slot) const
+    {
+        return { .origin = { originX[slot], originY[slot], originZ[slot] },
+                 .direction = { directionX[slot], directionY[slot], directionZ[slot] },
+                 .max = tMax[slot] };
+    }
+};
+}  // namespace dae
@@ -2,7 +2,12 @@
 #include <cstdint>
 #include <vector>
 
+#include "AccumulationBuffer.hpp"
 #include "DataTypes.hpp"
+#include "FrameBuffer.hpp"
+#include "Matrix.hpp"
+#include "RayQueue.hpp"
+#include "ReprojectionCache.hpp"
 #include "SDL_events.h"
 
 struct SDL_Window;
@@ -23,12 +28,28 @@ public:
     Renderer& operator=(const Renderer&) = delete;
     Renderer& operator=(Renderer&&) noexcept = delete;
 
-    void Render(Scene* pScene) const;
+    void Render(Scene* pScene);
     [[nodiscard]] bool SaveBufferToImage() const;
     void ProcessInput(const SDL_Event& e);
 
     void CycleLightingMode();
     void ToggleShadows();
+    void ToggleReprojection();
+    void CycleToneMappingOperator();
+    void ToggleSRGB();
+    void ToggleDithering();
+    void CycleIntegrator();
+
+    void ToggleLightSampling();
+    // Shadow samples per area light and hit, fewer are taken when the first few all agree
+    void SetAreaLightSamples(uint32_t samples);
+    // Lights picked from the light tree per hit while light sampling is on
+    void SetLightSamplesPerHit(uint32_t samples);
+
+    // The path tracer keeps adding passes until it has this many samples per pixel
+    void SetPathTracerSampleBudget(uint32_t samplesPerPixel);
+    // Passes per frame stop once this much time went by, at least one pass always runs
+    void SetPathTracerTimeBudget(float milliseconds);
     bool IsInShadow(const Scene* pScene, const Light& light, const HitRecord& closestHit) const;
     [[nodiscard]] ColorRGB CalculateLighting(const Scene* pScene, const HitRecord& closestHit) const;
 
@@ -42,16 +63,171 @@ private:
         Count
     };
 
+    enum class Integrator : uint8_t
+    {
+        PerPixel,             // Generate, intersect, shadow and shade one pixel at a time
+        TiledBatchedShadows,  // Per tile: primary hits, sorted shadow ray batches per light, then shading
+        Wavefront,            // Whole frame per stage with compacted SoA queues in between
+        PathTracer,           // Progressive multi-bounce path tracing into the accumulation buffer
+        Count
+    };
+
+    // pLightVisibility holds one precomputed visibility flag per light, nullptr traces the shadow rays while shading
+    using LightingKernel = ColorRGB (Renderer::*)(const Scene*, const HitRecord&, const uint8_t* pLightVisibility) const;
+
+    // Per frame state shared by the per-pixel and the per-tile render paths
+    struct FrameContext final
+    {
+        Matrix cameraToWorld;
+        Vector3 cameraOrigin;
+        float fov{};
+        float aspectRatio{};
+        LightingKernel shadeHit{};
+    };
+
+    struct ShadowRay final
+    {
+        Ray ray;
+        uint32_t hitIdx{};   // Index into the tile's primary hits
+        uint32_t sortKey{};  // Direction octant and coarse direction, groups rays that traverse the same geometry
+    };
+
+    // Queues of the wavefront integrator, sized for the whole frame and reused
+    struct WavefrontQueues final
+    {
+        RayQueue primaryRays;            // Primary slot == pixel index
+        std::vector<float> depthScales;  // Camera space z of the normalized view direction
+        std::vector<HitRecord> hits;
+        std::vector<uint8_t> needsShading;  // Hit that could not reuse a reprojected sample
+        std::vector<uint32_t> primarySlots;
+        std::vector<uint32_t> hitSlots;  // Compacted primary slots that need shading
+
+        RayQueue shadowRays;  // [primary slot][light]
+        std::vector<uint8_t> shadowRayStates;
+        std::vector<uint32_t> shadowRaySlots;
+        std::vector<uint32_t> activeShadowSlots;  // Compacted shadow slots that reach the shadow test stage
+        std::vector<uint8_t> lightVisibility;     // [primary slot][light]
+    };
+
+    // One path of the path tracer, a cache line each so visiting the paths in sorted order costs one line per path
+    struct alignas(64) PathState final
+    {
+        Ray ray;  // Next segment
+        ColorRGB throughput;
+        ColorRGB radiance;
+        uint32_t rngState{};
+    };
+
+    // Paths of the path tracer, one per pixel, sized for the whole frame and reused every pass
+    struct PathQueues final
+    {
+        std::vector<PathState> states;      // Path index == pixel index
+        std::vector<uint32_t> activePaths;  // Paths that are still bouncing
+        std::vector<uint32_t> nextActivePaths;
+        std::vector<uint8_t> isPathAlive;
+
+        // Ray sorting scratch
+        std::vector<uint32_t> sortKeys;
+        std::vector<uint32_t> nextSortKeys;
+        std::vector<uint32_t> radixHistograms;  // [chunk][digit]
+        std::vector<uint32_t> chunkIndices;
+    };
+
+    // Path tracer pass time per path with and without ray sorting, whichever is cheaper wins
+    struct RaySortStatistics final
+    {
+        float nanosecondsPerPath[2]{};  // [isSorted], moving averages
+        uint32_t passCount{};
+    };
+
+    struct PathTracerSettings final
+    {
+        uint32_t maxSamplesPerPixel{ 1024 };
+        float frameTimeBudgetMs{ 33.f };
+        uint32_t maxBounces{ 8 };
+        uint32_t russianRouletteDepth{ 3 };  // Bounces that always survive
+    };
+
+    static constexpr int TILE_SIZE{ 16 };
+    // Batches of bounced rays smaller than this are traced as they are, sorting them never pays off
+    static constexpr size_t RAY_SORT_THRESHOLD{ 1u << 15 };
+    // Every this many passes the path tracer retries the sorting choice it is not using, see RaySortStatistics
+    static constexpr uint32_t RAY_SORT_PROBE_INTERVAL{ 16 };
+    // Area light samples taken before checking whether they all agree on the visibility
+    static constexpr uint32_t AREA_LIGHT_PROBE_SAMPLES{ 4 };
+
+    // Shading specialized per lighting mode and shadow state, only computes the terms the mode uses
+    template<LightingMode lightingMode, bool shadowsEnabled>
+    [[nodiscard]] ColorRGB ShadeHit(const Scene* pScene, const HitRecord& closestHit, const uint8_t* pLightVisibility) const;
+    [[nodiscard]] LightingKernel SelectLightingKernel() const;
+    static bool IsOccluded(const Scene* pScene, const Light& light, const HitRecord& closestHit,
+                           OccluderReference& cachedOccluder);
+    // Builds the ray from the hit towards the light, false when the light is behind the surface
+    static bool GetShadowRay(const Light& light, const HitRecord& closestHit, Ray& shadowRay);
+    [[nodiscard]] static uint32_t GetDirectionSortKey(const Vector3& direction);
+
+    /**
+     * \brief Averages an area light over stratified Sobol samples, stopping after the probe samples when they are all
+     * lit or all shadowed
+     * \param evaluate Contribution of one unoccluded sample: (hitToLight, radiance, observedArea) -> ColorRGB
+     */
+    template<typename EvaluateSample>
+    [[nodiscard]] ColorRGB SampleAreaLight(const Scene* pScene, const Light& light, const HitRecord& closestHit,
+                                           OccluderReference& cachedOccluder, bool testShadows,
+                                           const EvaluateSample& evaluate) const;
+
+    // jitterX and jitterY place the ray inside the pixel, 0.5 is its center
+    [[nodiscard]] Ray GenerateViewRay(const FrameContext& frame, int px, int py, float& localDirectionZ, float jitterX = 0.5f,
+                                      float jitterY = 0.5f) const;
+    void RenderPixel(const Scene* pScene, const FrameContext& frame, int pixelIdx);
+
+    // Traces all primary hits of a tile, then the shadow rays light by light in sorted batches, then shades
+    void RenderTile(const Scene* pScene, const FrameContext& frame, int tileIdx);
+
+    // Runs each stage over the whole frame: ray generation, intersection, shadow rays, shadow tests, shading
+    void RenderWavefront(const Scene* pScene, const FrameContext& frame);
+
+    // Adds sample passes within the sample and time budgets, then displays the running average
+    void RenderPathTraced(const Scene* pScene, const FrameContext& frame);
+    // One sample per pixel, path by path or with sorted bounces, whichever was measured to be cheaper
+    void TracePaths(const Scene* pScene, const FrameContext& frame, uint32_t sampleIdx);
+    // Traces all paths a bounce at a time, large batches of bounced rays are sorted before intersection
+    void TracePathsSorted(const Scene* pScene, const FrameContext& frame, uint32_t sampleIdx);
+    [[nodiscard]] ColorRGB TracePath(const Scene* pScene, const FrameContext& frame, int pixelIdx, uint32_t sampleIdx) const;
+    [[nodiscard]] PathState StartPath(const FrameContext& frame, int pixelIdx, uint32_t sampleIdx) const;
+    // Intersects, shades and scatters one path segment, false when the path ends
+    [[nodiscard]] bool ExtendPath(const Scene* pScene, PathState& path, uint32_t bounce) const;
+    /**
+     * \brief Reorders the active paths by direction octant, then by Morton code of the ray origin within the batch's
+     * bounds, so neighbouring rays traverse the same nodes and geometry
+     */
+    void SortPaths();
+
     LightingMode m_CurrentLightingMode{ LightingMode::Combined };
     bool m_ShadowsEnabled{ true };
+    bool m_ReprojectionEnabled{ false };
+    Integrator m_Integrator{ Integrator::PerPixel };
+    bool m_LightSamplingEnabled{ false };
+    uint32_t m_LightSamplesPerHit{ 4 };
+    uint32_t m_AreaLightSamples{ 16 };
 
     SDL_Window* m_pWindow{};
 
     SDL_Surface* m_pBuffer{};
-    uint32_t* m_pBufferPixels{};
+    FrameBuffer m_FrameBuffer;
 
     int m_Width{};
     int m_Height{};
     std::vector<int> m_PixelIndices;
+    std::vector<int> m_TileIndices;
+    WavefrontQueues m_Wavefront;
+    PathQueues m_Paths;
+    RaySortStatistics m_RaySortStatistics;
+
+    PathTracerSettings m_PathTracerSettings;
+    AccumulationBuffer m_Accumulation;
+    Matrix m_AccumulationCamera;  // Camera the accumulated samples were traced from
+
+    ReprojectionCache m_ReprojectionCache;
 };
 }  // namespace dae
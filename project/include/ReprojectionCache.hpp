@@ -0,0 +1,92 @@
+#pragma once
+#include <algorithm>
+#include <atomic>
+#include <cstdint>
+#include <memory>
+#include <vector>
+
+#include "ColorRGB.hpp"
+#include "DataTypes.hpp"
+#include "Matrix.hpp"
+
+namespace dae
+{
+/**
+ * \brief Per-pixel cache of last frame's primary hits. Every frame the cached world-space hits are reprojected into the
+ * new camera, so pixels whose primary ray still sees the same surface can reuse their shading instead of shading again.
+ * Disoccluded pixels (nothing landed on them), samples at a different depth than the new primary hit and expired samples
+ * are reported as not reusable and must be shaded again.
+ */
+class ReprojectionCache final
+{
+public:
+    ReprojectionCache() = default;
+    ReprojectionCache(int width, int height);
+    ~ReprojectionCache() = default;
+
+    ReprojectionCache(const ReprojectionCache&) = delete;
+    ReprojectionCache(ReprojectionCache&&) noexcept = delete;
+    ReprojectionCache& operator=(const ReprojectionCache&) = delete;
+    ReprojectionCache& operator=(ReprojectionCache&&) noexcept = delete;
+
+    struct Sample final
+    {
+        HitRecord hit;
+        ColorRGB color;
+        float depth{};  // Camera space z of the hit
+
+        uint8_t age{};
+        bool isValid{ false };
+    };
+
+    /**
+     * \brief Scatters last frame's samples into the pixels they land on with the new camera (closest depth wins)
+     * \param worldToCamera Inverse of the new camera-to-world matrix
+     * \param fov tan(fovAngle / 2) of the camera
+     * \param aspectRatio width / height
+     */
+    void Reproject(const Matrix& worldToCamera, float fov, float aspectRatio);
+
+    // Drops every cached sample, the next frame gets traced in full
+    void Invalidate();
+
+    /**
+     * \brief True when the pixel holds a reprojected sample that is not scheduled for a progressive refresh this frame
+     * \param depth Camera space z of this frame's primary hit, the sample must lie on the same surface
+     */
+    [[nodiscard]] bool IsReusable(int pixelIdx, float depth) const;
+
+    [[nodiscard]] const Sample& GetSample(int pixelIdx) const
+    {
+        return m_Samples[pixelIdx];
+    }
+
+    // Stores a freshly traced primary hit, a miss leaves the pixel empty so it is traced again next frame
+    void Store(int pixelIdx, const HitRecord& hit, const ColorRGB& color, float depth);
+
+    void SetRefreshInterval(uint8_t frames)
+    {
+        m_RefreshInterval = std::max<uint8_t>(frames, 1);
+    }
+
+private:
+    static constexpr uint64_t EMPTY_TARGET{ UINT64_MAX };
+
+    // Relative depth difference up to which a reprojected sample still counts as the primary hit's surface
+    static constexpr float DEPTH_TOLERANCE{ 0.01f };
+
+    int m_Width{};
+    int m_Height{};
+    uint32_t m_FrameIndex{};
+
+    // Every pixel gets re-traced at least once per interval, samples older than twice the interval always expire
+    uint8_t m_RefreshInterval{ 8 };
+
+    std::vector<int> m_PixelIndices;
+    std::vector<Sample> m_Samples;
+    std::vector<Sample> m_PreviousSamples;
+
+    // Packed (depth bits << 32 | source pixel) per target pixel, used as a lock-free z-buffer during the scatter
+    std::unique_ptr<std::atomic<uint64_t>[]> m_ReprojectionTargets;
+};
+}  // namespace dae
@@ -1,9 +1,15 @@
 #pragma once
+#include <filesystem>
+#include <utility>
 #include <vector>
 
 #include "Camera.hpp"
 #include "DataTypes.hpp"
+#include "LightGrid.hpp"
+#include "LightTree.hpp"
+#include "SphereGrid.hpp"
 #include "Vector3.hpp"
+#include "WideBVH.hpp"
 
 namespace dae
 {
@@ -28,9 +34,36 @@ public:
 
     virtual void Initialize() = 0;
 
-    virtual void Update(dae::Timer* pTimer)
+    // Updates the camera and recomputes the meshes that were moved or edited
+    virtual void Update(dae::Timer* pTimer);
+
+    // What changed since the renderer last consumed the scene, anything cached from earlier frames depends on these
+    enum class DirtyFlag : uint8_t
+    {
+        Geometry = 1 << 0,
+        Materials = 1 << 1,
+        Lights = 1 << 2
+    };
+
+    void MarkDirty(DirtyFlag flag)
+    {
+        m_DirtyFlags |= static_cast<uint8_t>(flag);
+    }
+
+    [[nodiscard]] bool IsDirty(DirtyFlag flag) const
+    {
+        return (m_DirtyFlags & static_cast<uint8_t>(flag)) != 0;
+    }
+
+    [[nodiscard]] bool IsAnyDirty() const
+    {
+        return m_DirtyFlags != 0;
+    }
+
+    // Called by the renderer once the frame consumed the changes
+    void ClearDirtyFlags()
     {
-        m_Camera.Update(pTimer);
+        m_DirtyFlags = 0;
     }
 
     Camera& GetCamera()
@@ -46,6 +79,38 @@ public:
     void GetClosestHit(const Ray& ray, HitRecord& closestHit) const;
     [[nodiscard]] bool DoesHit(const Ray& ray) const;
 
+    /**
+     * \brief Any-hit query for shadow rays, stops at the first blocker. The cached occluder is tested first and
+     * updated on every hit, the rest is walked from the largest estimated occluder down.
+     */
+    [[nodiscard]] bool IsOccluded(const Ray& ray, OccluderReference& cachedOccluder) const;
+
+    // Re-sorts the any-hit traversal order when the geometry changed
+    void UpdateOccluderOrder();
+
+    // How ray queries find the spheres, brute force suits a handful of them
+    enum class SphereAcceleration : uint8_t
+    {
+        None,  // Every sphere, 8 at a time
+        BVH,   // WideBVH over the sphere bounds
+        Grid   // SphereGrid, builds in O(N) and suits many spheres of similar size
+    };
+
+    void SetSphereAcceleration(SphereAcceleration acceleration)
+    {
+        m_SphereAcceleration = acceleration;
+        m_IsSphereAccelerationDirty = true;
+        MarkDirty(DirtyFlag::Geometry);
+    }
+
+    [[nodiscard]] SphereAcceleration GetSphereAcceleration() const
+    {
+        return m_SphereAcceleration;
+    }
+
+    // Rebuilds the selected sphere acceleration structure when spheres were added or the selection changed
+    void UpdateSphereAcceleration();
+
     [[nodiscard]] const std::vector<Plane>& GetPlaneGeometries() const
     {
         return m_PlaneGeometries;
@@ -61,7 +126,34 @@ public:
         return m_Lights;
     }
 
-    [[nodiscard]] std::vector<Material*> GetMaterials() const
+    [[nodiscard]] const LightTree& GetLightTree() const
+    {
+        return m_LightTree;
+    }
+
+    [[nodiscard]] const LightGrid& GetLightGrid() const
+    {
+        return m_LightGrid;
+    }
+
+    // Rebuilds the light tree and grid when the lights or the influence threshold changed
+    void UpdateLightStructures();
+
+    // Radiance below which a point light is considered out of reach, zero gives every light unbounded reach
+    void SetLightInfluenceThreshold(float threshold)
+    {
+        m_LightInfluenceThreshold = threshold;
+        MarkDirty(DirtyFlag::Lights);
+    }
+
+    // Mutable access marks the lights dirty, the light structures rebuild before the next frame
+    [[nodiscard]] Light& EditLight(size_t lightIdx)
+    {
+        MarkDirty(DirtyFlag::Lights);
+        return m_Lights[lightIdx];
+    }
+
+    [[nodiscard]] const std::vector<Material*>& GetMaterials() const
     {
         return m_Materials;
     }
@@ -69,20 +161,57 @@ public:
 protected:
     std::vector<Plane> m_PlaneGeometries;
     std::vector<Sphere> m_SphereGeometries;
+    SphereSoA m_SphereStore;  // Mirrors m_SphereGeometries for the batched kernels
+    SphereAcceleration m_SphereAcceleration{ SphereAcceleration::None };
+    SphereGrid m_SphereGrid;
+    WideBVH m_SphereBVH;
+    std::vector<WideBVH::Bounds> m_SphereBounds;  // Build input of m_SphereBVH
+    bool m_IsSphereAccelerationDirty{ true };
     std::vector<TriangleMesh> m_TriangleMeshGeometries;
     std::vector<Triangle> m_Triangles;
     std::vector<Light> m_Lights;
+    LightTree m_LightTree;
+    LightGrid m_LightGrid;
+    float m_LightInfluenceThreshold{ LightGrid::DEFAULT_THRESHOLD };
     std::vector<Material*> m_Materials;
 
     Camera m_Camera;
 
-    Sphere* AddSphere(const Vector3& origin, float radius, unsigned char materialIndex = 0);
+    // Any-hit traversal order, largest estimated occluders first
+    std::vector<OccluderReference> m_OccluderOrder;
+
+    // Everything starts dirty so the first frame builds all derived structures
+    uint8_t m_DirtyFlags{ static_cast<uint8_t>(DirtyFlag::Geometry) | static_cast<uint8_t>(DirtyFlag::Materials) |
+                          static_cast<uint8_t>(DirtyFlag::Lights) };
+
+    // Spheres are mirrored into the SoA store and the sphere acceleration, so they are only edited through SetSphere
+    size_t AddSphere(const Vector3& origin, float radius, unsigned char materialIndex = 0);
+    void SetSphere(size_t sphereIdx, const Sphere& sphere);
     Plane* AddPlane(const Vector3& origin, const Vector3& normal, unsigned char materialIndex = 0);
     TriangleMesh* AddTriangleMesh(TriangleCullMode cullMode, unsigned char materialIndex = 0);
 
-    Light* AddPointLight(const Vector3& origin, float intensity, const ColorRGB& color);
-    Light* AddDirectionalLight(const Vector3& direction, float intensity, const ColorRGB& color);
+    // Lights return their index, later edits go through EditLight so the light structures see them
+    size_t AddPointLight(const Vector3& origin, float intensity, const ColorRGB& color);
+    size_t AddDirectionalLight(const Vector3& direction, float intensity, const ColorRGB& color);
+    // axisU and axisV are the half extents, the light emits along their cross product
+    size_t AddRectangleLight(const Vector3& origin, const Vector3& axisU, const Vector3& axisV, float intensity,
+                              const ColorRGB& color);
+    size_t AddDiskLight(const Vector3& origin, const Vector3& normal, float radius, float intensity, const ColorRGB& color);
+    size_t AddSphereLight(const Vector3& origin, float radius, float intensity, const ColorRGB& color);
     unsigned char AddMaterial(Material* pMaterial);
+
+private:
+    struct RankedOccluder final
+    {
+        OccluderReference occluder;
+        float score{};  // Rough projected area, bigger blockers are more likely to stop a shadow ray early
+    };
+
+    [[nodiscard]] bool DoesOccluderHit(const OccluderReference& occluder, const Ray& ray) const;
+    bool HitTestSpheres(const Ray& ray, HitRecord& hitRecord, bool ignoreHitRecord = false) const;
+
+    // Scratch of UpdateOccluderOrder, kept so re-ranking after every geometry change does not touch the heap
+    std::vector<RankedOccluder> m_RankedOccluders;
 };
 
 //+++++++++++++++++++++++++++++++++++++++++
@@ -129,10 +258,16 @@ public:
     void Initialize() override;
 };
 
+// The bunny mesh is stored compact, quantizePositions also drops its positions to 16 bits per axis
 class Scene_W4_BunnyScene final : public Scene
 {
 public:
-    Scene_W4_BunnyScene() = default;
+    // A non-empty bvhCacheDirectory switches the bunny to an SAH tree cached there, see TriangleMesh::bvhCacheDirectory
+    explicit Scene_W4_BunnyScene(bool quantizePositions = false, std::filesystem::path bvhCacheDirectory = {})
+        : m_QuantizePositions{ quantizePositions }
+        , m_BVHCacheDirectory{ std::move(bvhCacheDirectory) }
+    {
+    }
     ~Scene_W4_BunnyScene() override = default;
 
     Scene_W4_BunnyScene(Scene_W4_BunnyScene&&) = delete;
@@ -142,6 +277,10 @@ public:
 
     void Initialize() override;
     void Update(Timer* pTimer) override;
+
+private:
+    bool m_QuantizePositions;
+    std::filesystem::path m_BVHCacheDirectory;
 };
 
 class Scene_W4_ReferenceScene final : public Scene
@@ -159,4 +298,42 @@ public:
     void Update(Timer* pTimer) override;
 };
 
+// The W3 spheres lit by a rectangle, a disk and a sphere light, for soft shadows
+class Scene_W4_AreaLightScene final : public Scene
+{
+public:
+    Scene_W4_AreaLightScene() = default;
+    ~Scene_W4_AreaLightScene() override = default;
+
+    Scene_W4_AreaLightScene(Scene_W4_AreaLightScene&&) = delete;
+    Scene_W4_AreaLightScene(const Scene_W4_AreaLightScene&) = delete;
+    Scene_W4_AreaLightScene& operator=(Scene_W4_AreaLightScene&&) = delete;
+    Scene_W4_AreaLightScene& operator=(const Scene_W4_AreaLightScene&) = delete;
+
+    void Initialize() override;
+};
+
+// Sphere acceleration benchmark: a jittered lattice of FIELD_SIZE^3 similar spheres, rendered with the given structure
+class Scene_SphereField final : public Scene
+{
+public:
+    static constexpr int FIELD_SIZE{ 16 };
+
+    explicit Scene_SphereField(SphereAcceleration acceleration)
+        : m_Acceleration{ acceleration }
+    {
+    }
+    ~Scene_SphereField() override = default;
+
+    Scene_SphereField(Scene_SphereField&&) = delete;
+    Scene_SphereField(const Scene_SphereField&) = delete;
+    Scene_SphereField& operator=(Scene_SphereField&&) = delete;
+    Scene_SphereField& operator=(const Scene_SphereField&) = delete;
+
+    void Initialize() override;
+
+private:
+    SphereAcceleration m_Acceleration;
+};
+
 }  // namespace dae
@@ -0,0 +1,89 @@
+#pragma once
+#include <cstdint>
+#include <span>
+#include <vector>
+
+#include "DataTypes.hpp"
+#include "Vector3.hpp"
+
+namespace dae
+{
+/**
+ * \brief Uniform grid over the spheres of a SphereSoA, traversed cell by cell with a 3D-DDA, see
+ * GeometryUtils::Traverse_SphereGrid. Every sphere is listed in the cells its bounding box overlaps. The build is two
+ * linear passes (count, then fill) and the resolution follows the sphere count: roughly CELLS_PER_SPHERE cells per sphere,
+ * as close to cubic as the bounds allow. Works best for many spheres of similar size, a few large ones among many small
+ * ones end up listed in a lot of cells.
+ */
+class SphereGrid final
+{
+public:
+    static constexpr float CELLS_PER_SPHERE{ 2.f };
+    static constexpr int MAX_CELLS_PER_AXIS{ 128 };
+
+    SphereGrid() = default;
+    ~SphereGrid() = default;
+
+    SphereGrid(const SphereGrid&) = delete;
+    SphereGrid(SphereGrid&&) noexcept = delete;
+    SphereGrid& operator=(const SphereGrid&) = delete;
+    SphereGrid& operator=(SphereGrid&&) noexcept = delete;
+
+    void Build(const SphereSoA& spheres);
+
+    [[nodiscard]] bool IsEmpty() const
+    {
+        return m_CellOffsets.empty();
+    }
+
+    [[nodiscard]] const Vector3& GetBoundsMin() const
+    {
+        return m_BoundsMin;
+    }
+
+    [[nodiscard]] const Vector3& GetBoundsMax() const
+    {
+        return m_BoundsMax;
+    }
+
+    [[nodiscard]] const Vector3& GetCellSize() const
+    {
+        return m_CellSize;
+    }
+
+    [[nodiscard]] const Vector3& GetInverseCellSize() const
+    {
+        return m_InverseCellSize;
+    }
+
+    [[nodiscard]] int GetCellCount(int axis) const
+    {
+        return m_CellCount[axis];
+    }
+
+    [[nodiscard]] int GetCellIndex(int x, int y, int z) const
+    {
+        return x + (m_CellCount[0] * (y + (m_CellCount[1] * z)));
+    }
+
+    // Indices into the SphereSoA of the spheres overlapping the cell
+    [[nodiscard]] std::span<const uint32_t> GetSpheres(int cellIdx) const
+    {
+        const uint32_t first{ m_CellOffsets[cellIdx] };
+        return { m_CellSpheres.data() + first, m_CellOffsets[cellIdx + 1] - first };
+    }
+
+private:
+    void SelectResolution(size_t sphereCount);
+
+    Vector3 m_BoundsMin;
+    Vector3 m_BoundsMax;
+    Vector3 m_CellSize;
+    Vector3 m_InverseCellSize;
+    int m_CellCount[3]{};
+
+    // Sphere lists of all cells back to back, cell i owns [m_CellOffsets[i], m_CellOffsets[i + 1])
+    std::vector<uint32_t> m_CellOffsets;
+    std::vector<uint32_t> m_CellSpheres;
+};
+}  // namespace dae
@@ -1,4 +1,6 @@
 #pragma once
+#include <algorithm>
+#include <bit>
 #include <cmath>
 #include <cstdint>
 #include <fstream>
@@ -7,8 +9,13 @@
 #include "ColorRGB.hpp"
 #include "DataTypes.hpp"
 #include "MathHelpers.hpp"
+#include "SphereGrid.hpp"
 #include "Vector3.hpp"
 
+#if defined(__AVX2__)
+#include <immintrin.h>
+#endif
+
 namespace dae
 {
 namespace GeometryUtils
@@ -67,6 +74,169 @@ inline bool HitTest_Sphere(const Sphere& sphere, const Ray& ray)
     return HitTest_Sphere(sphere, ray, temp, true);
 }
 
+// Any-hit test of one ray against the BATCH_SIZE spheres starting at firstIdx
+inline bool HitTest_SphereBatch(const SphereSoA& spheres, size_t firstIdx, const Ray& ray)
+{
+#if defined(__AVX2__)
+    const __m256 toCenterX{ _mm256_sub_ps(_mm256_loadu_ps(&spheres.originX[firstIdx]), _mm256_set1_ps(ray.origin.x)) };
+    const __m256 toCenterY{ _mm256_sub_ps(_mm256_loadu_ps(&spheres.originY[firstIdx]), _mm256_set1_ps(ray.origin.y)) };
+    const __m256 toCenterZ{ _mm256_sub_ps(_mm256_loadu_ps(&spheres.originZ[firstIdx]), _mm256_set1_ps(ray.origin.z)) };
+
+    const __m256 tRayCenter{ _mm256_fmadd_ps(toCenterX, _mm256_set1_ps(ray.direction.x),
+                                             _mm256_fmadd_ps(toCenterY, _mm256_set1_ps(ray.direction.y),
+                                                             _mm256_mul_ps(toCenterZ, _mm256_set1_ps(ray.direction.z)))) };
+    const __m256 toCenterSqr{ _mm256_fmadd_ps(toCenterX, toCenterX,
+                                              _mm256_fmadd_ps(toCenterY, toCenterY, _mm256_mul_ps(toCenterZ, toCenterZ))) };
+    const __m256 halfChordSqr{ _mm256_sub_ps(_mm256_loadu_ps(&spheres.radiusSquared[firstIdx]),
+                                             _mm256_fnmadd_ps(tRayCenter, tRayCenter, toCenterSqr)) };
+    const __m256 t{ _mm256_sub_ps(tRayCenter, _mm256_sqrt_ps(_mm256_max_ps(halfChordSqr, _mm256_setzero_ps()))) };
+
+    const __m256 hitMask{ _mm256_and_ps(_mm256_and_ps(_mm256_cmp_ps(halfChordSqr, _mm256_setzero_ps(), _CMP_GT_OQ),
+                                                      _mm256_cmp_ps(t, _mm256_set1_ps(ray.min), _CMP_GE_OQ)),
+                                        _mm256_cmp_ps(t, _mm256_set1_ps(ray.max), _CMP_LE_OQ)) };
+    return _mm256_movemask_ps(hitMask) != 0;
+#else
+    for(size_t sphereIdx{ firstIdx }; sphereIdx < firstIdx + SphereSoA::BATCH_SIZE; ++sphereIdx)
+    {
+        const Vector3 toCenter{ spheres.originX[sphereIdx] - ray.origin.x, spheres.originY[sphereIdx] - ray.origin.y,
+                                spheres.originZ[sphereIdx] - ray.origin.z };
+        const float tRayCenter{ Vector3::Dot(toCenter, ray.direction) };
+        const float halfChordSqr{ spheres.radiusSquared[sphereIdx] - (toCenter.SqrMagnitude() - (tRayCenter * tRayCenter)) };
+        if(halfChordSqr <= 0.f)
+            continue;
+
+        const float t{ tRayCenter - sqrtf(halfChordSqr) };
+        if(t >= ray.min and t <= ray.max)
+            return true;
+    }
+    return false;
+#endif
+}
+
+// Entry distance of one sphere of the SoA store, FLT_MAX when the ray misses it or enters outside [min, max]
+inline float GetSphereEntry(const SphereSoA& spheres, size_t sphereIdx, const Ray& ray)
+{
+    const Vector3 toCenter{ spheres.originX[sphereIdx] - ray.origin.x, spheres.originY[sphereIdx] - ray.origin.y,
+                            spheres.originZ[sphereIdx] - ray.origin.z };
+    const float tRayCenter{ Vector3::Dot(toCenter, ray.direction) };
+    const float halfChordSqr{ spheres.radiusSquared[sphereIdx] - (toCenter.SqrMagnitude() - (tRayCenter * tRayCenter)) };
+    if(halfChordSqr <= 0.f)
+        return FLT_MAX;
+
+    const float t{ tRayCenter - sqrtf(halfChordSqr) };
+    return t >= ray.min and t <= ray.max ? t : FLT_MAX;
+}
+
+inline void SetSphereHitRecord(const SphereSoA& spheres, size_t sphereIdx, const Ray& ray, float t, HitRecord& hitRecord)
+{
+    const Vector3 center{ spheres.originX[sphereIdx], spheres.originY[sphereIdx], spheres.originZ[sphereIdx] };
+    const Vector3 hitPoint{ ray.origin + (t * ray.direction) };
+    hitRecord.origin = hitPoint;
+    hitRecord.didHit = true;
+    hitRecord.t = t;
+    hitRecord.materialIndex = spheres.materialIndices[sphereIdx];
+    hitRecord.normal = (hitPoint - center).Normalized();
+}
+
+/**
+ * \brief Tests one ray against every sphere of the SoA store, 8 per iteration with AVX2. Same geometric test as
+ * HitTest_Sphere (entry point only, no hits from inside). Closest-hit keeps a per-lane minimum and reduces it once
+ * at the end, any-hit returns on the first batch that hits.
+ */
+inline bool HitTest_Spheres(const SphereSoA& spheres, const Ray& ray, HitRecord& hitRecord, bool ignoreHitRecord = false)
+{
+    if(ignoreHitRecord)
+    {
+        for(size_t firstIdx{}; firstIdx < spheres.GetPaddedSize(); firstIdx += SphereSoA::BATCH_SIZE)
+        {
+            if(HitTest_SphereBatch(spheres, firstIdx, ray))
+                return true;
+        }
+        return false;
+    }
+
+    float closestT{ ray.max };
+    size_t closestIdx{ spheres.GetPaddedSize() };
+    size_t sphereIdx{};
+
+#if defined(__AVX2__)
+    const __m256 originX{ _mm256_set1_ps(ray.origin.x) };
+    const __m256 originY{ _mm256_set1_ps(ray.origin.y) };
+    const __m256 originZ{ _mm256_set1_ps(ray.origin.z) };
+    const __m256 directionX{ _mm256_set1_ps(ray.direction.x) };
+    const __m256 directionY{ _mm256_set1_ps(ray.direction.y) };
+    const __m256 directionZ{ _mm256_set1_ps(ray.direction.z) };
+    const __m256 tMin{ _mm256_set1_ps(ray.min) };
+
+    __m256 bestT{ _mm256_set1_ps(ray.max) };
+    __m256i bestIdx{ _mm256_set1_epi32(-1) };
+    __m256i laneIdx{ _mm256_setr_epi32(0, 1, 2, 3, 4, 5, 6, 7) };
+    const __m256i laneStep{ _mm256_set1_epi32(SphereSoA::BATCH_SIZE) };
+
+    for(; sphereIdx < spheres.GetPaddedSize(); sphereIdx += SphereSoA::BATCH_SIZE)
+    {
+        const __m256 toCenterX{ _mm256_sub_ps(_mm256_loadu_ps(&spheres.originX[sphereIdx]), originX) };
+        const __m256 toCenterY{ _mm256_sub_ps(_mm256_loadu_ps(&spheres.originY[sphereIdx]), originY) };
+        const __m256 toCenterZ{ _mm256_sub_ps(_mm256_loadu_ps(&spheres.originZ[sphereIdx]), originZ) };
+        const __m256 radiusSquared{ _mm256_loadu_ps(&spheres.radiusSquared[sphereIdx]) };
+
+        const __m256 tRayCenter{ _mm256_fmadd_ps(
+            toCenterX, directionX, _mm256_fmadd_ps(toCenterY, directionY, _mm256_mul_ps(toCenterZ, directionZ))) };
+        const __m256 toCenterSqr{ _mm256_fmadd_ps(
+            toCenterX, toCenterX, _mm256_fmadd_ps(toCenterY, toCenterY, _mm256_mul_ps(toCenterZ, toCenterZ))) };
+        const __m256 originRayDistanceSqr{ _mm256_fnmadd_ps(tRayCenter, tRayCenter, toCenterSqr) };
+
+        const __m256 halfChordSqr{ _mm256_sub_ps(radiusSquared, originRayDistanceSqr) };
+        const __m256 t{ _mm256_sub_ps(tRayCenter, _mm256_sqrt_ps(_mm256_max_ps(halfChordSqr, _mm256_setzero_ps()))) };
+
+        const __m256 hitMask{ _mm256_and_ps(
+            _mm256_and_ps(_mm256_cmp_ps(halfChordSqr, _mm256_setzero_ps(), _CMP_GT_OQ), _mm256_cmp_ps(t, tMin, _CMP_GE_OQ)),
+            _mm256_cmp_ps(t, bestT, _CMP_LT_OQ)) };
+
+        bestT = _mm256_blendv_ps(bestT, t, hitMask);
+        bestIdx = _mm256_blendv_epi8(bestIdx, laneIdx, _mm256_castps_si256(hitMask));
+        laneIdx = _mm256_add_epi32(laneIdx, laneStep);
+    }
+
+    // Min-reduction over the lanes
+    alignas(32) float laneT[SphereSoA::BATCH_SIZE];
+    alignas(32) int32_t laneBestIdx[SphereSoA::BATCH_SIZE];
+    _mm256_store_ps(laneT, bestT);
+    _mm256_store_si256(reinterpret_cast<__m256i*>(laneBestIdx), bestIdx);
+    for(size_t lane{}; lane < SphereSoA::BATCH_SIZE; ++lane)
+    {
+        if(laneBestIdx[lane] >= 0 and laneT[lane] < closestT)
+        {
+            closestT = laneT[lane];
+            closestIdx = static_cast<size_t>(laneBestIdx[lane]);
+        }
+    }
+#endif
+
+    for(; sphereIdx < spheres.GetPaddedSize(); ++sphereIdx)
+    {
+        const Vector3 toCenter{ spheres.originX[sphereIdx] - ray.origin.x, spheres.originY[sphereIdx] - ray.origin.y,
+                                spheres.originZ[sphereIdx] - ray.origin.z };
+        const float tRayCenter{ Vector3::Dot(toCenter, ray.direction) };
+        const float halfChordSqr{ spheres.radiusSquared[sphereIdx] - (toCenter.SqrMagnitude() - (tRayCenter * tRayCenter)) };
+        if(halfChordSqr <= 0.f)
+            continue;
+
+        const float t{ tRayCenter - sqrtf(halfChordSqr) };
+        if(t < ray.min or t >= closestT)
+            continue;
+
+        closestT = t;
+        closestIdx = sphereIdx;
+    }
+
+    if(closestIdx >= spheres.count)
+        return false;
+
+    SetSphereHitRecord(spheres, closestIdx, ray, closestT, hitRecord);
+    return true;
+}
+
 #pragma endregion
 #pragma region Plane HitTest
 
@@ -101,47 +271,28 @@ inline bool HitTest_Plane(const Plane& plane, const Ray& ray)
 #pragma region Triangle HitTest
 
 // TRIANGLE HIT-TESTS
-inline bool HitTest_Triangle(const Triangle& triangle, const Ray& ray, HitRecord& hitRecord, bool ignoreHitRecord = false)
+/**
+ * \brief Whether a triangle facing the ray with the given cosine is culled. Any-hit (shadow) rays travel away from the
+ * shaded surface, so they see the opposite face and the culled side is inverted.
+ */
+template<TriangleCullMode cullMode, bool isAnyHit>
+constexpr bool IsCulled(float vn)
 {
-    const auto vn{ Vector3::Dot(ray.direction, triangle.normal) };
-    if(AreEqual(vn, 0.f))
+    if constexpr(cullMode == TriangleCullMode::FrontFaceCulling)
+        return isAnyHit ? vn > 0 : vn < 0;
+    else if constexpr(cullMode == TriangleCullMode::BackFaceCulling)
+        return isAnyHit ? vn < 0 : vn > 0;
+    else
         return false;
+}
 
-    switch(triangle.cullMode)
-    {
-        case TriangleCullMode::FrontFaceCulling:
-            if(ignoreHitRecord)
-            {
-                if(vn > 0)
-                    return false;
-            }
-            else
-            {
-                if(vn < 0)
-                {
-                    hitRecord.didHit = false;
-                    return false;
-                }
-            }
-            break;
-        case TriangleCullMode::BackFaceCulling:
-            if(ignoreHitRecord)
-            {
-                if(vn < 0)
-                    return false;
-            }
-            else
-            {
-                if(vn > 0)
-                {
-                    hitRecord.didHit = false;
-                    return false;
-                }
-            }
-            break;
-        case TriangleCullMode::NoCulling:
-            break;
-    }
+// Closest-hit (fills the hitRecord) or any-hit kernel with the cull mode resolved at compile time
+template<TriangleCullMode cullMode, bool isAnyHit>
+inline bool HitTest_Triangle(const Triangle& triangle, const Ray& ray, HitRecord& hitRecord)
+{
+    const auto vn{ Vector3::Dot(ray.direction, triangle.normal) };
+    if(AreEqual(vn, 0.f) or IsCulled<cullMode, isAnyHit>(vn))
+        return false;
 
     const auto rayToVert{ triangle.v0 - ray.origin };
     const auto t{ Vector3::Dot(rayToVert, triangle.normal) / vn };
@@ -150,27 +301,42 @@ inline bool HitTest_Triangle(const Triangle& triangle, const Ray& ray, HitRecord
         return false;
 
     const auto hitPoint{ ray.origin + (ray.direction * t) };
-    auto isPointOutTriangle = [hitPoint, triangle](const Vector3& vertex1, const Vector3& vertex2) -> bool
+    auto isPointOutTriangle = [hitPoint, &triangle](const Vector3& vertex1, const Vector3& vertex2) -> bool
     {
         const Vector3 e{ vertex1, vertex2 };
         const Vector3 p{ vertex1, hitPoint };
         return Vector3::Dot(Vector3::Cross(e, p), triangle.normal) < 0;
     };
 
-    if(not(isPointOutTriangle(triangle.v0, triangle.v1) or isPointOutTriangle(triangle.v1, triangle.v2) or
-           isPointOutTriangle(triangle.v2, triangle.v0)))
+    if(isPointOutTriangle(triangle.v0, triangle.v1) or isPointOutTriangle(triangle.v1, triangle.v2) or
+       isPointOutTriangle(triangle.v2, triangle.v0))
+        return false;
+
+    if constexpr(not isAnyHit)
     {
-        if(not ignoreHitRecord)
-        {
-            hitRecord.origin = hitPoint;
-            hitRecord.didHit = true;
-            hitRecord.t = t;
-            hitRecord.materialIndex = triangle.materialIndex;
-            hitRecord.normal = triangle.normal;
-        }
-        return true;
+        hitRecord.origin = hitPoint;
+        hitRecord.didHit = true;
+        hitRecord.t = t;
+        hitRecord.materialIndex = triangle.materialIndex;
+        hitRecord.normal = triangle.normal;
     }
+    return true;
+}
 
+inline bool HitTest_Triangle(const Triangle& triangle, const Ray& ray, HitRecord& hitRecord, bool ignoreHitRecord = false)
+{
+    switch(triangle.cullMode)
+    {
+        case TriangleCullMode::FrontFaceCulling:
+            return ignoreHitRecord ? HitTest_Triangle<TriangleCullMode::FrontFaceCulling, true>(triangle, ray, hitRecord)
+                                   : HitTest_Triangle<TriangleCullMode::FrontFaceCulling, false>(triangle, ray, hitRecord);
+        case TriangleCullMode::BackFaceCulling:
+            return ignoreHitRecord ? HitTest_Triangle<TriangleCullMode::BackFaceCulling, true>(triangle, ray, hitRecord)
+                                   : HitTest_Triangle<TriangleCullMode::BackFaceCulling, false>(triangle, ray, hitRecord);
+        case TriangleCullMode::NoCulling:
+            return ignoreHitRecord ? HitTest_Triangle<TriangleCullMode::NoCulling, true>(triangle, ray, hitRecord)
+                                   : HitTest_Triangle<TriangleCullMode::NoCulling, false>(triangle, ray, hitRecord);
+    }
     return false;
 }
 
@@ -206,34 +372,398 @@ inline bool SlabTest_TriangleMesh(const TriangleMesh& mesh, const Ray& ray)
     return tmax > 0 and tmax >= tmin;
 }
 
-inline bool HitTest_TriangleMesh(const TriangleMesh& mesh, const Ray& ray, HitRecord& hitRecord, bool ignoreHitRecord = false)
+/**
+ * \brief Per-ray setup of the wide node slab test: the inverse direction, and per axis whether the ray runs towards
+ * negative coordinates so the near and far planes can be picked without a min/max per child.
+ */
+struct WideNodeRay final
 {
-    if(not GeometryUtils::SlabTest_TriangleMesh(mesh, ray))
+    explicit WideNodeRay(const Ray& ray)
+        : origin{ ray.origin }
+        , inverseDirection{ 1.f / ray.direction.x, 1.f / ray.direction.y, 1.f / ray.direction.z }
+        , isNegative{ ray.direction.x < 0.f, ray.direction.y < 0.f, ray.direction.z < 0.f }
+    {
+    }
+
+    Vector3 origin;
+    Vector3 inverseDirection;
+    bool isNegative[3];
+};
+
+/**
+ * \brief SlabTest_TriangleMesh on all children of a wide BVH node at once. Returns one bit per child whose box the ray
+ * overlaps within [tMin, tMax] and writes the entry distances to pTNear (WideBVH::WIDTH floats).
+ */
+inline uint32_t SlabTest_WideNode(const WideBVH::Node& node, const WideNodeRay& ray, float tMin, float tMax, float* pTNear)
+{
+    const float nodeOrigin[3]{ node.origin.x, node.origin.y, node.origin.z };
+    const float nodeScale[3]{ node.scale.x, node.scale.y, node.scale.z };
+    const float rayOrigin[3]{ ray.origin.x, ray.origin.y, ray.origin.z };
+    const float inverseDirection[3]{ ray.inverseDirection.x, ray.inverseDirection.y, ray.inverseDirection.z };
+    const uint8_t* const nearPlanes[3]{ ray.isNegative[0] ? node.maxX : node.minX, ray.isNegative[1] ? node.maxY : node.minY,
+                                        ray.isNegative[2] ? node.maxZ : node.minZ };
+    const uint8_t* const farPlanes[3]{ ray.isNegative[0] ? node.minX : node.maxX, ray.isNegative[1] ? node.minY : node.maxY,
+                                       ray.isNegative[2] ? node.minZ : node.maxZ };
+    const uint32_t childMask{ (1u << node.childCount) - 1 };
+
+#if defined(__AVX2__)
+    static_assert(WideBVH::WIDTH == 8, "One AVX2 lane per child");
+
+    auto decode = [](const uint8_t* pQuantized, __m256 scale, __m256 origin) -> __m256
+    {
+        const __m128i bytes{ _mm_loadl_epi64(reinterpret_cast<const __m128i*>(pQuantized)) };
+        return _mm256_fmadd_ps(_mm256_cvtepi32_ps(_mm256_cvtepu8_epi32(bytes)), scale, origin);
+    };
+
+    // The accumulator goes second in max/min, so a NaN slab (0 * inf for rays in a box plane) is ignored
+    __m256 tNear{ _mm256_set1_ps(tMin) };
+    __m256 tFar{ _mm256_set1_ps(tMax) };
+    for(int axis{}; axis < 3; ++axis)
+    {
+        const __m256 scale{ _mm256_set1_ps(nodeScale[axis]) };
+        const __m256 origin{ _mm256_set1_ps(nodeOrigin[axis]) };
+        const __m256 start{ _mm256_set1_ps(rayOrigin[axis]) };
+        const __m256 inverse{ _mm256_set1_ps(inverseDirection[axis]) };
+
+        const __m256 tNearPlane{ _mm256_mul_ps(_mm256_sub_ps(decode(nearPlanes[axis], scale, origin), start), inverse) };
+        const __m256 tFarPlane{ _mm256_mul_ps(_mm256_sub_ps(decode(farPlanes[axis], scale, origin), start), inverse) };
+        tNear = _mm256_max_ps(tNearPlane, tNear);
+        tFar = _mm256_min_ps(tFarPlane, tFar);
+    }
+
+    _mm256_storeu_ps(pTNear, tNear);
+    const auto hitMask{ static_cast<uint32_t>(_mm256_movemask_ps(_mm256_cmp_ps(tNear, tFar, _CMP_LE_OQ))) };
+    return hitMask & childMask;
+#else
+    uint32_t hitMask{};
+    for(uint32_t childIdx{}; childIdx < WideBVH::WIDTH; ++childIdx)
+    {
+        float tNear{ tMin };
+        float tFar{ tMax };
+        for(int axis{}; axis < 3; ++axis)
+        {
+            const float nearPlane{ std::fma(static_cast<float>(nearPlanes[axis][childIdx]), nodeScale[axis], nodeOrigin[axis]) };
+            const float farPlane{ std::fma(static_cast<float>(farPlanes[axis][childIdx]), nodeScale[axis], nodeOrigin[axis]) };
+            const float tNearPlane{ (nearPlane - rayOrigin[axis]) * inverseDirection[axis] };
+            const float tFarPlane{ (farPlane - rayOrigin[axis]) * inverseDirection[axis] };
+            tNear = tNearPlane > tNear ? tNearPlane : tNear;
+            tFar = tFarPlane < tFar ? tFarPlane : tFar;
+        }
+
+        pTNear[childIdx] = tNear;
+        if(tNear <= tFar)
+            hitMask |= 1u << childIdx;
+    }
+    return hitMask & childMask;
+#endif
+}
+
+/**
+ * \brief Calls testPrimitive(primitiveIdx) for the primitives in every BVH leaf the ray reaches. Children are visited
+ * nearest first and testPrimitive is expected to shrink ray.max on a hit, which culls the subtrees behind it. Any-hit
+ * stops at the first primitive that reports a hit.
+ */
+template<bool isAnyHit, typename TestPrimitive>
+inline bool Traverse_WideBVH(const WideBVH& bvh, Ray& ray, const TestPrimitive& testPrimitive)
+{
+    struct StackEntry final
+    {
+        uint32_t child;
+        float tNear;
+    };
+
+    const std::span<const WideBVH::Node> nodes{ bvh.GetNodes() };
+    const std::span<const uint32_t> primitiveIndices{ bvh.GetPrimitiveIndices() };
+    const WideNodeRay nodeRay{ ray };
+
+    // The root's own box is left to the caller (SlabTest_TriangleMesh for meshes), its children are tested below
+    StackEntry stack[WideBVH::MAX_STACK_SIZE];
+    stack[0] = { .child = 0, .tNear = ray.min };
+    uint32_t stackSize{ 1 };
+
+    bool didHit{ false };
+    while(stackSize > 0)
+    {
+        const StackEntry entry{ stack[--stackSize] };
+        if(entry.tNear > ray.max)
+            continue;
+
+        if(entry.child & WideBVH::LEAF_FLAG)
+        {
+            const uint32_t first{ entry.child & WideBVH::LEAF_FIRST_MASK };
+            const uint32_t count{ (entry.child & ~WideBVH::LEAF_FLAG) >> WideBVH::LEAF_COUNT_SHIFT };
+            for(uint32_t idx{ first }; idx < first + count; ++idx)
+            {
+                if(testPrimitive(primitiveIndices[idx]))
+                {
+                    if constexpr(isAnyHit)
+                        return true;
+
+                    didHit = true;
+                }
+            }
+            continue;
+        }
+
+        const WideBVH::Node& node{ nodes[entry.child] };
+        alignas(32) float tNear[WideBVH::WIDTH];
+        uint32_t hitMask{ SlabTest_WideNode(node, nodeRay, ray.min, ray.max, tNear) };
+
+        // Insertion sort the pushed children by decreasing distance, so the nearest one is popped next
+        const uint32_t firstPushed{ stackSize };
+        while(hitMask != 0)
+        {
+            const auto childIdx{ static_cast<uint32_t>(std::countr_zero(hitMask)) };
+            hitMask &= hitMask - 1;
+
+            uint32_t slot{ stackSize++ };
+            if constexpr(not isAnyHit)
+            {
+                for(; slot > firstPushed and stack[slot - 1].tNear < tNear[childIdx]; --slot)
+                    stack[slot] = stack[slot - 1];
+            }
+            stack[slot] = { .child = node.children[childIdx], .tNear = tNear[childIdx] };
+        }
+    }
+    return didHit;
+}
+
+// The BVH when the mesh has one, every triangle otherwise
+template<bool isAnyHit, typename TestTriangle>
+inline bool TestTriangleCandidates(const TriangleMesh& mesh, Ray& ray, const TestTriangle& testTriangle)
+{
+    if(not mesh.bvh.IsEmpty())
+        return Traverse_WideBVH<isAnyHit>(mesh.bvh, ray, testTriangle);
+
+    bool didHit{ false };
+    for(uint32_t triIndex{}; triIndex < mesh.triangleRecords.size(); ++triIndex)
+    {
+        if(testTriangle(triIndex))
+        {
+            if constexpr(isAnyHit)
+                return true;
+
+            didHit = true;
+        }
+    }
+    return didHit;
+}
+
+// Same culling and range semantics as HitTest_Triangle, on a precomputed record (written out per component so the
+// loop stays free of calls)
+template<TriangleCullMode cullMode, bool isAnyHit>
+inline bool HitTest_TriangleRecord(const TriangleRecord& record, const Ray& ray, HitRecord& hitRecord)
+{
+    const Vector3& n{ record.normal };
+    const float vn{ (ray.direction.x * n.x) + (ray.direction.y * n.y) + (ray.direction.z * n.z) };
+    if(AreEqual(vn, 0.f) or IsCulled<cullMode, isAnyHit>(vn))
         return false;
 
-    size_t triIndex{};
-    HitRecord closestHit;
-    for(size_t i{}; i < mesh.indices.size(); i += 3)
+    const float t{ (record.planeD - ((ray.origin.x * n.x) + (ray.origin.y * n.y) + (ray.origin.z * n.z))) / vn };
+    if(t < ray.min or t > ray.max)
+        return false;
+
+    const float px{ ray.origin.x + (ray.direction.x * t) - record.v0.x };
+    const float py{ ray.origin.y + (ray.direction.y * t) - record.v0.y };
+    const float pz{ ray.origin.z + (ray.direction.z * t) - record.v0.z };
+
+    const float beta{ (px * record.betaAxis.x) + (py * record.betaAxis.y) + (pz * record.betaAxis.z) };
+    const float gamma{ (px * record.gammaAxis.x) + (py * record.gammaAxis.y) + (pz * record.gammaAxis.z) };
+    if(beta < 0.f or gamma < 0.f or beta + gamma > 1.f)
+        return false;
+
+    if constexpr(not isAnyHit)
+    {
+        hitRecord.origin = { px + record.v0.x, py + record.v0.y, pz + record.v0.z };
+        hitRecord.didHit = true;
+        hitRecord.t = t;
+        hitRecord.normal = n;
+    }
+    return true;
+}
+
+/**
+ * \brief Per-ray setup of the watertight test (Woop et al. 2013): the ray direction is mapped to +z by permuting and
+ * shearing. The permutation is folded into three row vectors, so transforming a vertex is three branch-free dot products.
+ */
+struct WatertightRay final
+{
+    explicit WatertightRay(const Ray& ray)
+        : origin{ ray.origin }
     {
-        Triangle tri{ mesh.transformedVertices[mesh.indices[i + 0]], mesh.transformedVertices[mesh.indices[i + 1]],
-                      mesh.transformedVertices[mesh.indices[i + 2]], mesh.transformedNormals[triIndex], mesh.cullMode };
-        ++triIndex;
+        const Vector3 absDirection{ std::abs(ray.direction.x), std::abs(ray.direction.y), std::abs(ray.direction.z) };
+        const int kz{ absDirection.x > absDirection.y ? (absDirection.x > absDirection.z ? 0 : 2)
+                                                      : (absDirection.y > absDirection.z ? 1 : 2) };
+        int kx{ (kz + 1) % 3 };
+        int ky{ (kx + 1) % 3 };
 
-        HitRecord currentHit{};
-        if(HitTest_Triangle(tri, ray, currentHit, ignoreHitRecord) and ignoreHitRecord)
-            return true;
+        // Keep the winding of the edge functions
+        if(ray.direction[kz] < 0.f)
+            std::swap(kx, ky);
+
+        const float shearX{ ray.direction[kx] / ray.direction[kz] };
+        const float shearY{ ray.direction[ky] / ray.direction[kz] };
 
-        if(currentHit.t < closestHit.t)
-            closestHit = currentHit;
+        shearRowX[kx] = 1.f;
+        shearRowX[kz] = -shearX;
+        shearRowY[ky] = 1.f;
+        shearRowY[kz] = -shearY;
+        shearRowZ[kz] = 1.f / ray.direction[kz];
     }
 
-    if(not ignoreHitRecord)
+    Vector3 origin;
+    Vector3 shearRowX;
+    Vector3 shearRowY;
+    Vector3 shearRowZ;
+};
+
+template<TriangleCullMode cullMode, bool isAnyHit>
+inline bool HitTest_TriangleWatertight(const Vector3& v0, const Vector3& v1, const Vector3& v2, const Vector3& normal,
+                                       const Ray& ray, const WatertightRay& watertightRay, HitRecord& hitRecord)
+{
+    const float vn{ (ray.direction.x * normal.x) + (ray.direction.y * normal.y) + (ray.direction.z * normal.z) };
+    if(IsCulled<cullMode, isAnyHit>(vn))
+        return false;
+
+    auto shear = [&watertightRay](const Vector3& vertex, const Vector3& row) -> float
     {
-        hitRecord = closestHit;
-        hitRecord.materialIndex = mesh.materialIndex;
+        return ((vertex.x - watertightRay.origin.x) * row.x) + ((vertex.y - watertightRay.origin.y) * row.y) +
+            ((vertex.z - watertightRay.origin.z) * row.z);
+    };
 
-        if(hitRecord.didHit)
-            return true;
+    const float ax{ shear(v0, watertightRay.shearRowX) };
+    const float ay{ shear(v0, watertightRay.shearRowY) };
+    const float bx{ shear(v1, watertightRay.shearRowX) };
+    const float by{ shear(v1, watertightRay.shearRowY) };
+    const float cx{ shear(v2, watertightRay.shearRowX) };
+    const float cy{ shear(v2, watertightRay.shearRowY) };
+
+    float u{ (cx * by) - (cy * bx) };
+    float v{ (ax * cy) - (ay * cx) };
+    float w{ (bx * ay) - (by * ax) };
+
+    // An edge function of exactly zero may be rounding on a shared edge or vertex. Redo them in double, where the float
+    // products are exact, so the neighbouring triangle sees exactly the negated value and the ray can't slip through.
+    if(u == 0.f or v == 0.f or w == 0.f)
+    {
+        u = static_cast<float>((static_cast<double>(cx) * by) - (static_cast<double>(cy) * bx));
+        v = static_cast<float>((static_cast<double>(ax) * cy) - (static_cast<double>(ay) * cx));
+        w = static_cast<float>((static_cast<double>(bx) * ay) - (static_cast<double>(by) * ax));
+    }
+
+    if((u < 0.f or v < 0.f or w < 0.f) and (u > 0.f or v > 0.f or w > 0.f))
+        return false;
+
+    const float determinant{ u + v + w };
+    if(determinant == 0.f)
+        return false;
+
+    const float scaledT{ (u * shear(v0, watertightRay.shearRowZ)) + (v * shear(v1, watertightRay.shearRowZ)) +
+                         (w * shear(v2, watertightRay.shearRowZ)) };
+    const float t{ scaledT / determinant };
+    if(t < ray.min or t > ray.max)
+        return false;
+
+    if constexpr(not isAnyHit)
+    {
+        hitRecord.origin = ray.origin + (ray.direction * t);
+        hitRecord.didHit = true;
+        hitRecord.t = t;
+        hitRecord.normal = normal;
+    }
+    return true;
+}
+
+template<TriangleCullMode cullMode, bool isAnyHit>
+inline bool HitTest_TriangleMeshWatertight(const TriangleMesh& mesh, const Ray& ray, HitRecord& hitRecord)
+{
+    const WatertightRay watertightRay{ ray };
+
+    // max shrinks to the closest hit so far
+    Ray closestRay{ ray };
+    HitRecord closestHit;
+    auto testTriangle = [&](uint32_t triIndex) -> bool
+    {
+        HitRecord currentHit{};
+        if(not HitTest_TriangleWatertight<cullMode, isAnyHit>(
+               mesh.transformedVertices.Get(mesh.GetIndex((triIndex * 3) + 0)),
+               mesh.transformedVertices.Get(mesh.GetIndex((triIndex * 3) + 1)),
+               mesh.transformedVertices.Get(mesh.GetIndex((triIndex * 3) + 2)), mesh.triangleRecords[triIndex].normal,
+               closestRay, watertightRay, currentHit))
+            return false;
+
+        if constexpr(not isAnyHit)
+        {
+            if(currentHit.t < closestHit.t)
+            {
+                closestHit = currentHit;
+                closestRay.max = currentHit.t;
+            }
+        }
+        return true;
+    };
+
+    const bool didHit{ TestTriangleCandidates<isAnyHit>(mesh, closestRay, testTriangle) };
+    if constexpr(isAnyHit)
+        return didHit;
+
+    hitRecord = closestHit;
+    hitRecord.materialIndex = mesh.materialIndex;
+    return hitRecord.didHit;
+}
+
+// Triangle loop with the mesh's cull mode bound once, no per-triangle branching on it
+template<TriangleCullMode cullMode, bool isAnyHit>
+inline bool HitTest_TriangleMesh(const TriangleMesh& mesh, const Ray& ray, HitRecord& hitRecord)
+{
+    if(mesh.isWatertight)
+        return HitTest_TriangleMeshWatertight<cullMode, isAnyHit>(mesh, ray, hitRecord);
+
+    // max shrinks to the closest hit so far
+    Ray closestRay{ ray };
+    HitRecord closestHit;
+    auto testTriangle = [&](uint32_t triIndex) -> bool
+    {
+        HitRecord currentHit{};
+        if(not HitTest_TriangleRecord<cullMode, isAnyHit>(mesh.triangleRecords[triIndex], closestRay, currentHit))
+            return false;
+
+        if constexpr(not isAnyHit)
+        {
+            if(currentHit.t < closestHit.t)
+            {
+                closestHit = currentHit;
+                closestRay.max = currentHit.t;
+            }
+        }
+        return true;
+    };
+
+    const bool didHit{ TestTriangleCandidates<isAnyHit>(mesh, closestRay, testTriangle) };
+    if constexpr(isAnyHit)
+        return didHit;
+
+    hitRecord = closestHit;
+    hitRecord.materialIndex = mesh.materialIndex;
+    return hitRecord.didHit;
+}
+
+inline bool HitTest_TriangleMesh(const TriangleMesh& mesh, const Ray& ray, HitRecord& hitRecord, bool ignoreHitRecord = false)
+{
+    if(not GeometryUtils::SlabTest_TriangleMesh(mesh, ray))
+        return false;
+
+    switch(mesh.cullMode)
+    {
+        case TriangleCullMode::FrontFaceCulling:
+            return ignoreHitRecord ? HitTest_TriangleMesh<TriangleCullMode::FrontFaceCulling, true>(mesh, ray, hitRecord)
+                                   : HitTest_TriangleMesh<TriangleCullMode::FrontFaceCulling, false>(mesh, ray, hitRecord);
+        case TriangleCullMode::BackFaceCulling:
+            return ignoreHitRecord ? HitTest_TriangleMesh<TriangleCullMode::BackFaceCulling, true>(mesh, ray, hitRecord)
+                                   : HitTest_TriangleMesh<TriangleCullMode::BackFaceCulling, false>(mesh, ray, hitRecord);
+        case TriangleCullMode::NoCulling:
+            return ignoreHitRecord ? HitTest_TriangleMesh<TriangleCullMode::NoCulling, true>(mesh, ray, hitRecord)
+                                   : HitTest_TriangleMesh<TriangleCullMode::NoCulling, false>(mesh, ray, hitRecord);
     }
     return false;
 }
@@ -244,6 +774,157 @@ inline bool HitTest_TriangleMesh(const TriangleMesh& mesh, const Ray& ray)
     return HitTest_TriangleMesh(mesh, ray, temp, true);
 }
 
+#pragma endregion
+#pragma region Sphere Acceleration HitTest
+
+/**
+ * \brief Amanatides-Woo 3D-DDA: calls testSphere(sphereIdx) for the spheres of every grid cell the ray passes through,
+ * front to back. testSphere is expected to shrink ray.max on a hit, the walk stops once the next cell starts beyond it,
+ * nothing further along can be closer. A sphere spanning several cells can be tested more than once. Any-hit stops at the
+ * first sphere that reports a hit.
+ */
+template<bool isAnyHit, typename TestSphere>
+inline bool Traverse_SphereGrid(const SphereGrid& grid, Ray& ray, const TestSphere& testSphere)
+{
+    if(grid.IsEmpty())
+        return false;
+
+    const float origin[3]{ ray.origin.x, ray.origin.y, ray.origin.z };
+    const float direction[3]{ ray.direction.x, ray.direction.y, ray.direction.z };
+    const Vector3& boundsMin{ grid.GetBoundsMin() };
+    const Vector3& boundsMax{ grid.GetBoundsMax() };
+    const float gridMin[3]{ boundsMin.x, boundsMin.y, boundsMin.z };
+    const float gridMax[3]{ boundsMax.x, boundsMax.y, boundsMax.z };
+
+    // Clip the ray to the grid
+    float tEnter{ ray.min };
+    float tExit{ ray.max };
+    for(int axis{}; axis < 3; ++axis)
+    {
+        if(direction[axis] == 0.f)
+        {
+            if(origin[axis] < gridMin[axis] or origin[axis] > gridMax[axis])
+                return false;
+            continue;
+        }
+
+        const float inverseDirection{ 1.f / direction[axis] };
+        const float tNearPlane{ (gridMin[axis] - origin[axis]) * inverseDirection };
+        const float tFarPlane{ (gridMax[axis] - origin[axis]) * inverseDirection };
+        tEnter = std::max(tEnter, std::min(tNearPlane, tFarPlane));
+        tExit = std::min(tExit, std::max(tNearPlane, tFarPlane));
+    }
+    if(tEnter > tExit)
+        return false;
+
+    const Vector3& cellSize{ grid.GetCellSize() };
+    const Vector3& inverseCellSize{ grid.GetInverseCellSize() };
+    const float cellSizes[3]{ cellSize.x, cellSize.y, cellSize.z };
+    const float inverseCellSizes[3]{ inverseCellSize.x, inverseCellSize.y, inverseCellSize.z };
+
+    int cell[3]{};
+    int step[3]{};
+    int cellEnd[3]{};
+    float tNext[3]{};
+    float tDelta[3]{};
+    for(int axis{}; axis < 3; ++axis)
+    {
+        const float entry{ origin[axis] + (direction[axis] * tEnter) };
+        cell[axis] = std::clamp(static_cast<int>((entry - gridMin[axis]) * inverseCellSizes[axis]), 0,
+                                grid.GetCellCount(axis) - 1);
+        const float cellMin{ gridMin[axis] + (static_cast<float>(cell[axis]) * cellSizes[axis]) };
+
+        if(direction[axis] > 0.f)
+        {
+            step[axis] = 1;
+            cellEnd[axis] = grid.GetCellCount(axis);
+            tNext[axis] = (cellMin + cellSizes[axis] - origin[axis]) / direction[axis];
+            tDelta[axis] = cellSizes[axis] / direction[axis];
+        }
+        else if(direction[axis] < 0.f)
+        {
+            step[axis] = -1;
+            cellEnd[axis] = -1;
+            tNext[axis] = (cellMin - origin[axis]) / direction[axis];
+            tDelta[axis] = -cellSizes[axis] / direction[axis];
+        }
+        else
+        {
+            // Never stepped along, reaching this axis means every axis ran out
+            cellEnd[axis] = cell[axis];
+            tNext[axis] = FLT_MAX;
+        }
+    }
+
+    bool didHit{ false };
+    while(true)
+    {
+        for(const uint32_t sphereIdx : grid.GetSpheres(grid.GetCellIndex(cell[0], cell[1], cell[2])))
+        {
+            if(testSphere(sphereIdx))
+            {
+                if constexpr(isAnyHit)
+                    return true;
+
+                didHit = true;
+            }
+        }
+
+        const int axis{ tNext[0] < tNext[1] ? (tNext[0] < tNext[2] ? 0 : 2) : (tNext[1] < tNext[2] ? 1 : 2) };
+        if(tNext[axis] > ray.max)
+            return didHit;
+
+        cell[axis] += step[axis];
+        if(cell[axis] == cellEnd[axis])
+            return didHit;
+        tNext[axis] += tDelta[axis];
+    }
+}
+
+template<bool isAnyHit, typename TestSphere>
+inline bool TestSphereCandidates(const SphereGrid& grid, Ray& ray, const TestSphere& testSphere)
+{
+    return Traverse_SphereGrid<isAnyHit>(grid, ray, testSphere);
+}
+
+template<bool isAnyHit, typename TestSphere>
+inline bool TestSphereCandidates(const WideBVH& bvh, Ray& ray, const TestSphere& testSphere)
+{
+    return Traverse_WideBVH<isAnyHit>(bvh, ray, testSphere);
+}
+
+/**
+ * \brief HitTest_Spheres through an acceleration structure over the same store, a SphereGrid or a WideBVH built on the
+ * sphere bounds. Only the spheres along the ray are tested, roughly nearest first.
+ */
+template<typename Acceleration>
+inline bool HitTest_Spheres(const Acceleration& acceleration, const SphereSoA& spheres, const Ray& ray, HitRecord& hitRecord,
+                            bool ignoreHitRecord = false)
+{
+    // max shrinks to the closest hit so far
+    Ray closestRay{ ray };
+    size_t closestIdx{};
+    auto testSphere = [&](uint32_t sphereIdx) -> bool
+    {
+        const float t{ GetSphereEntry(spheres, sphereIdx, closestRay) };
+        if(t == FLT_MAX)
+            return false;
+
+        closestRay.max = t;
+        closestIdx = sphereIdx;
+        return true;
+    };
+
+    if(ignoreHitRecord)
+        return TestSphereCandidates<true>(acceleration, closestRay, testSphere);
+
+    if(not TestSphereCandidates<false>(acceleration, closestRay, testSphere))
+        return false;
+
+    SetSphereHitRecord(spheres, closestIdx, ray, closestRay.max, hitRecord);
+    return true;
+}
+
 #pragma endregion
 }  // namespace GeometryUtils
 
@@ -278,6 +959,107 @@ inline ColorRGB GetRadiance(const Light& light, const Vector3& target)
             return {};
     }
 }
+
+inline bool IsAreaLight(const Light& light)
+{
+    return light.type == LightType::Rectangle or light.type == LightType::Disk or light.type == LightType::Sphere;
+}
+
+// Largest distance from the light origin to a point of its emitting surface
+inline float GetLightExtent(const Light& light)
+{
+    switch(light.type)
+    {
+        case LightType::Rectangle:
+            return (light.axisU + light.axisV).Magnitude();
+        case LightType::Disk:
+        case LightType::Sphere:
+            return light.radius;
+        default:
+            return 0.f;
+    }
+}
+
+// Distance beyond which the radiance of the light stays below threshold in every channel, unbounded for directional
+inline float GetInfluenceRadius(const Light& light, float threshold)
+{
+    if(light.type == LightType::Directional or threshold <= 0.f)
+        return FLT_MAX;
+
+    const float peak{ light.intensity * std::max({ light.color.r, light.color.g, light.color.b }) };
+    return std::sqrt(std::max(peak, 0.f) / threshold) + GetLightExtent(light);
+}
+
+struct AreaLightSample final
+{
+    Vector3 point;
+    ColorRGB radiance;  // Arriving at the target from point, the full intensity as if the light sat at point
+};
+
+/**
+ * \brief Maps a 2D sample to a point on an area light. The light behaves like a point light of the same intensity at
+ * the sampled point, one sided emitters also weigh it by the emission cosine.
+ * \param light Rectangle, disk or sphere light
+ * \param target Point being lit, spheres are only sampled on the half facing it
+ * \param u1 Sample in [0, 1)
+ * \param u2 Sample in [0, 1)
+ */
+inline AreaLightSample SampleAreaLight(const Light& light, const Vector3& target, float u1, float u2)
+{
+    Vector3 point{ light.origin };
+    float emissionCosine{ 1.f };
+    switch(light.type)
+    {
+        case LightType::Rectangle:
+        {
+            point = light.origin + (light.axisU * ((2.f * u1) - 1.f)) + (light.axisV * ((2.f * u2) - 1.f));
+            break;
+        }
+        case LightType::Disk:
+        {
+            // Concentric mapping keeps the strata of the square compact on the disk
+            const float a{ (2.f * u1) - 1.f };
+            const float b{ (2.f * u2) - 1.f };
+            float r{};
+            float phi{};
+            if(a * a > b * b)
+            {
+                r = a;
+                phi = PI_DIV_4 * (b / a);
+            }
+            else if(b != 0.f)
+            {
+                r = b;
+                phi = PI_DIV_2 - (PI_DIV_4 * (a / b));
+            }
+            point = light.origin + (light.axisU * (r * std::cos(phi))) + (light.axisV * (r * std::sin(phi)));
+            break;
+        }
+        case LightType::Sphere:
+        {
+            const float z{ 1.f - (2.f * u1) };
+            const float ring{ std::sqrt(std::max(0.f, 1.f - (z * z))) };
+            const float phi{ PI_2 * u2 };
+            Vector3 offset{ ring * std::cos(phi), ring * std::sin(phi), z };
+
+            // Mirror onto the visible half
+            if(Vector3::Dot(offset, target - light.origin) < 0.f)
+                offset = -offset;
+
+            point = light.origin + (offset * light.radius);
+            break;
+        }
+        default:
+            break;
+    }
+
+    const Vector3 pointToTarget{ target - point };
+    const float distanceSqr{ pointToTarget.SqrMagnitude() };
+    if(light.type == LightType::Rectangle or light.type == LightType::Disk)
+        emissionCosine = std::max(0.f, Vector3::Dot(light.direction, pointToTarget) / std::sqrt(distanceSqr));
+
+    return { .point = point, .radiance = light.color * (light.intensity * emissionCosine / distanceSqr) };
+}
 }  // namespace LightUtils
 
 namespace Utils
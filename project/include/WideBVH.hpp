@@ -0,0 +1,173 @@
+#pragma once
+#include <cfloat>
+#include <cstddef>
+#include <cstdint>
+#include <filesystem>
+#include <memory>
+#include <span>
+#include <vector>
+
+#include "MappedFile.hpp"
+#include "Vector3.hpp"
+
+namespace dae
+{
+/**
+ * \brief 8-wide bounding volume hierarchy over a mesh's triangles. Nodes are stored depth-first in one contiguous array
+ * and take two cache lines each: the node's own box as origin and scale, its children's boxes quantized to 8 bits on
+ * that grid and one word per child. A traversal step loads one node and slab tests all children at once, see
+ * GeometryUtils::SlabTest_WideNode.
+ *
+ * A built tree can be cached on disk, see BuildCached. A cache hit maps the file and the tree is read straight from the
+ * mapping, it is only copied out when Refit has to change it.
+ */
+class WideBVH final
+{
+public:
+    static constexpr uint32_t WIDTH{ 8 };
+    static constexpr uint32_t MAX_LEAF_SIZE{ 4 };
+    static constexpr uint32_t MAX_STACK_SIZE{ 512 };
+
+    // Child words: node index, or LEAF_FLAG | count << LEAF_COUNT_SHIFT | first entry of GetPrimitiveIndices()
+    static constexpr uint32_t LEAF_FLAG{ 1u << 31 };
+    static constexpr uint32_t LEAF_COUNT_SHIFT{ 24 };
+    static constexpr uint32_t LEAF_FIRST_MASK{ (1u << LEAF_COUNT_SHIFT) - 1 };
+
+    enum class BuildMethod : uint8_t
+    {
+        SAH,    // Binned SAH splits, the better tree for geometry that is built once
+        Linear  // LBVH: splits on 30-bit Morton codes of the centroids, fast enough to rebuild every update
+    };
+
+    struct Bounds final
+    {
+        Vector3 min{ FLT_MAX, FLT_MAX, FLT_MAX };
+        Vector3 max{ -FLT_MAX, -FLT_MAX, -FLT_MAX };
+
+        void Grow(const Bounds& bounds)
+        {
+            min = Vector3::Min(min, bounds.min);
+            max = Vector3::Max(max, bounds.max);
+        }
+
+        void Grow(const Vector3& point)
+        {
+            min = Vector3::Min(min, point);
+            max = Vector3::Max(max, point);
+        }
+
+        [[nodiscard]] float GetHalfArea() const
+        {
+            const Vector3 extent{ max - min };
+            return (extent.x * extent.y) + (extent.y * extent.z) + (extent.z * extent.x);
+        }
+    };
+
+    // A child box decodes as origin + quantized * scale per axis, rounded outwards so it always contains the child
+    struct alignas(64) Node final
+    {
+        Vector3 origin;
+        Vector3 scale;
+        uint8_t minX[WIDTH];
+        uint8_t minY[WIDTH];
+        uint8_t minZ[WIDTH];
+        uint8_t maxX[WIDTH];
+        uint8_t maxY[WIDTH];
+        uint8_t maxZ[WIDTH];
+        uint32_t children[WIDTH];
+        uint32_t childCount;  // Children are packed at the front
+    };
+    static_assert(sizeof(Node) == 128, "A node should span exactly two cache lines");
+
+    WideBVH() = default;
+    ~WideBVH() = default;
+
+    // Moving keeps the vectors' buffers, so the views stay valid. A copy would still point into the source.
+    WideBVH(const WideBVH&) = delete;
+    WideBVH(WideBVH&&) noexcept = default;
+    WideBVH& operator=(const WideBVH&) = delete;
+    WideBVH& operator=(WideBVH&&) noexcept = default;
+
+    // Builds a new topology, the subtrees below the root are built in parallel
+    void Build(std::span<const Bounds> primitiveBounds, BuildMethod method = BuildMethod::SAH);
+
+    /**
+     * \brief Build() through a cache in directory. The file is named after a hash of the primitive boxes as passed in and
+     * the build parameters, so any change to the input misses. A hit maps the file instead of building, a miss builds and
+     * saves. For a TriangleMesh the boxes are world space, the key then covers its transform at build time too.
+     */
+    void BuildCached(std::span<const Bounds> primitiveBounds, BuildMethod method, const std::filesystem::path& directory);
+
+    // Keeps the topology and recomputes every box bottom-up, for primitives that moved but did not change
+    void Refit(std::span<const Bounds> primitiveBounds);
+
+    [[nodiscard]] bool IsEmpty() const
+    {
+        return m_NodeView.empty();
+    }
+
+    [[nodiscard]] bool IsMapped() const
+    {
+        return m_pMappedFile != nullptr;
+    }
+
+    [[nodiscard]] size_t GetPrimitiveCount() const
+    {
+        return m_PrimitiveIndexView.size();
+    }
+
+    [[nodiscard]] std::span<const Node> GetNodes() const
+    {
+        return m_NodeView;
+    }
+
+    [[nodiscard]] std::span<const uint32_t> GetPrimitiveIndices() const
+    {
+        return m_PrimitiveIndexView;
+    }
+
+private:
+    struct PrimitiveRange final
+    {
+        uint32_t first{};
+        uint32_t count{};
+        Bounds bounds;
+    };
+
+    uint32_t BuildNode(const PrimitiveRange& range, std::span<const Bounds> primitiveBounds, uint32_t depth,
+                       std::vector<Node>& nodes, std::vector<Bounds>& nodeBounds);
+    uint32_t OpenRange(const PrimitiveRange& range, std::span<const Bounds> primitiveBounds, uint32_t depth,
+                       PrimitiveRange (&childRanges)[WIDTH]);
+    void SplitRange(const PrimitiveRange& range, std::span<const Bounds> primitiveBounds, bool forceMedian, PrimitiveRange& left,
+                    PrimitiveRange& right);
+    void SplitRangeMorton(const PrimitiveRange& range, PrimitiveRange& left, PrimitiveRange& right) const;
+    void SortByMortonCode(std::span<const Bounds> primitiveBounds);
+    [[nodiscard]] bool LoadCache(const std::filesystem::path& path, uint64_t key, size_t primitiveCount);
+    [[nodiscard]] bool SaveCache(const std::filesystem::path& path, uint64_t key) const;
+    void UseOwnedStorage();
+    [[nodiscard]] Bounds GetRangeBounds(uint32_t first, uint32_t count, std::span<const Bounds> primitiveBounds) const;
+    static void QuantizeChildren(Node& node, const Bounds& nodeBounds, std::span<const Bounds> childBounds);
+
+    std::vector<Node> m_Nodes;
+    std::vector<Bounds> m_NodeBounds;  // Full precision box per node, only read by Refit
+    std::vector<uint32_t> m_PrimitiveIndices;
+
+    // The tree as traversed, either the vectors above or a mapped cache file
+    std::span<const Node> m_NodeView;
+    std::span<const Bounds> m_NodeBoundsView;
+    std::span<const uint32_t> m_PrimitiveIndexView;
+    std::unique_ptr<MappedFile> m_pMappedFile;
+    BuildMethod m_BuildMethod{ BuildMethod::SAH };
+
+    // Build scratch, kept so rebuilding every update does not touch the heap
+    std::vector<Vector3> m_Centroids;
+    std::vector<uint32_t> m_MortonCodes;  // Per entry of m_PrimitiveIndices, sorted along with it
+    std::vector<uint32_t> m_SortedCodes;
+    std::vector<uint32_t> m_SortedIndices;
+    std::vector<Bounds> m_SortedBounds;
+    std::vector<uint32_t> m_RadixHistograms;
+    std::vector<uint32_t> m_ChunkIndices;
+    std::vector<Node> m_SubtreeNodes[WIDTH];
+    std::vector<Bounds> m_SubtreeNodeBounds[WIDTH];
+};
+}  // namespace dae
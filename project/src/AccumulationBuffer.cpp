@@ -0,0 +1,21 @@
+#include "AccumulationBuffer.hpp"
+
+#include <algorithm>
+
+namespace dae
+{
+AccumulationBuffer::AccumulationBuffer(int pixelCount)
+    : m_Red(static_cast<size_t>(pixelCount))
+    , m_Green(static_cast<size_t>(pixelCount))
+    , m_Blue(static_cast<size_t>(pixelCount))
+{
+}
+
+void AccumulationBuffer::Reset()
+{
+    m_SampleCount = 0;
+    std::ranges::fill(m_Red, 0.f);
+    std::ranges::fill(m_Green, 0.f);
+    std::ranges::fill(m_Blue, 0.f);
+}
+}  // namespace dae
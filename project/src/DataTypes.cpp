@@ -0,0 +1,212 @@
+#include "DataTypes.hpp"
+
+#include <algorithm>
+
+#include "ParallelUtils.hpp"
+
+namespace dae
+{
+namespace
+{
+// Elements per parallel task, a multiple of VertexStream::BATCH_SIZE so only the last chunk ends on padding
+constexpr size_t TRANSFORM_CHUNK_SIZE{ 4096 };
+
+template<bool isPoint, typename InputType>
+void TransformStream(std::vector<uint32_t>& chunkIndices, const Matrix& transform, const InputType* pX, const InputType* pY,
+                     const InputType* pZ, VertexStream& destination)
+{
+    ForEachChunk(chunkIndices, destination.GetPaddedSize(), TRANSFORM_CHUNK_SIZE,
+                 [&transform, pX, pY, pZ, &destination](size_t begin, size_t end)
+                 {
+                     if constexpr(isPoint)
+                         transform.TransformPoints(pX + begin, pY + begin, pZ + begin, &destination.x[begin],
+                                                   &destination.y[begin], &destination.z[begin], end - begin);
+                     else
+                         transform.TransformVectors(pX + begin, pY + begin, pZ + begin, &destination.x[begin],
+                                                    &destination.y[begin], &destination.z[begin], end - begin);
+                 });
+}
+
+// Move assigning an empty container frees the storage, clear() would keep it
+template<typename Container>
+void ReleaseStorage(Container& container)
+{
+    container = Container{};
+}
+}  // namespace
+
+void TriangleMesh::UpdateTransforms()
+{
+    // Constructors and AppendTriangle transform before the first Update()
+    if(not isCompact and (objectVertices.count != vertices.size() or objectNormals.count != normals.size()))
+        UpdateVertexStreams();
+
+    const Matrix finalTransform = scaleTransform * rotationTransform * translationTransform;
+
+    transformedVertices.Resize(GetVertexCount());
+    if(compactStorage.HasQuantizedPositions())
+    {
+        // Decoding is minObjectAABB + quantized * positionScale, applied in front of the mesh transform
+        const Matrix decodeTransform = Matrix::CreateScale(compactStorage.positionScale) *
+                                       Matrix::CreateTranslation(minObjectAABB) * finalTransform;
+        TransformStream<true>(transformChunkIndices, decodeTransform, compactStorage.positionX.data(),
+                              compactStorage.positionY.data(), compactStorage.positionZ.data(), transformedVertices);
+    }
+    else
+    {
+        TransformStream<true>(transformChunkIndices, finalTransform, objectVertices.x.data(), objectVertices.y.data(),
+                              objectVertices.z.data(), transformedVertices);
+    }
+
+    // Compact normals are decoded per triangle while building the records instead
+    if(not isCompact)
+    {
+        // The rotation has no translation, the vector path is the same transform without the add
+        transformedNormals.Resize(normals.size());
+        TransformStream<false>(transformChunkIndices, rotationTransform, objectNormals.x.data(), objectNormals.y.data(),
+                               objectNormals.z.data(), transformedNormals);
+    }
+
+    UpdateTransformedAABB(finalTransform);
+    UpdateTriangleRecords();
+    UpdateBVH();
+    isTransformDirty = false;
+}
+
+void TriangleMesh::UpdateTriangleRecords()
+{
+    const size_t indexCount{ compactStorage.indices.empty() ? indices.size() : compactStorage.indices.size() };
+    triangleRecords.resize(indexCount / 3);
+    ForEachChunk(transformChunkIndices, triangleRecords.size(), TRANSFORM_CHUNK_SIZE,
+                 [this](size_t begin, size_t end)
+                 {
+                     for(size_t triIndex{ begin }; triIndex < end; ++triIndex)
+                     {
+                         const Vector3 normal{ isCompact ? rotationTransform.TransformVector(CompactMeshStorage::DecodeNormal(
+                                                               compactStorage.normals[triIndex]))
+                                                         : transformedNormals.Get(triIndex) };
+                         triangleRecords[triIndex] = { transformedVertices.Get(GetIndex((triIndex * 3) + 0)),
+                                                       transformedVertices.Get(GetIndex((triIndex * 3) + 1)),
+                                                       transformedVertices.Get(GetIndex((triIndex * 3) + 2)), normal };
+                     }
+                 });
+}
+
+void TriangleMesh::UpdateBVH()
+{
+    triangleBounds.resize(triangleRecords.size());
+    ForEachChunk(transformChunkIndices, triangleBounds.size(), TRANSFORM_CHUNK_SIZE,
+                 [this](size_t begin, size_t end)
+                 {
+                     for(size_t triIndex{ begin }; triIndex < end; ++triIndex)
+                     {
+                         WideBVH::Bounds bounds{};
+                         for(size_t corner{}; corner < 3; ++corner)
+                             bounds.Grow(transformedVertices.Get(GetIndex((triIndex * 3) + corner)));
+                         triangleBounds[triIndex] = bounds;
+                     }
+                 });
+
+    // A new transform leaves the triangles and their grouping as they were, only the boxes need refitting
+    if(isBVHDirty or bvhBuildMethod == WideBVH::BuildMethod::Linear or bvh.GetPrimitiveCount() != triangleBounds.size())
+    {
+        if(bvhBuildMethod == WideBVH::BuildMethod::SAH and not bvhCacheDirectory.empty())
+            bvh.BuildCached(triangleBounds, bvhBuildMethod, bvhCacheDirectory);
+        else
+            bvh.Build(triangleBounds, bvhBuildMethod);
+        isBVHDirty = false;
+    }
+    else
+        bvh.Refit(triangleBounds);
+}
+
+void TriangleMesh::UpdateVertexStreams()
+{
+    // New geometry, the BVH topology has to be rebuilt
+    isBVHDirty = true;
+
+    objectVertices.Resize(vertices.size());
+    for(size_t vertexIdx{}; vertexIdx < vertices.size(); ++vertexIdx)
+        objectVertices.Set(vertexIdx, vertices[vertexIdx]);
+
+    objectNormals.Resize(normals.size());
+    for(size_t normalIdx{}; normalIdx < normals.size(); ++normalIdx)
+        objectNormals.Set(normalIdx, normals[normalIdx]);
+}
+
+void TriangleMesh::Compact(bool quantizePositions)
+{
+    if(isCompact)
+        return;
+
+    // Quantization is relative to the object AABB, the float streams cover the unquantized fallback
+    if(isGeometryDirty)
+        UpdateAABB();
+    UpdateVertexStreams();
+
+    compactStorage.vertexCount = vertices.size();
+    if(quantizePositions)
+    {
+        // Flat axes keep a unit step, every vertex then quantizes to zero on them
+        const Vector3 extent{ maxObjectAABB - minObjectAABB };
+        compactStorage.positionScale = { extent.x > 0.f ? extent.x / UINT16_MAX : 1.f,
+                                         extent.y > 0.f ? extent.y / UINT16_MAX : 1.f,
+                                         extent.z > 0.f ? extent.z / UINT16_MAX : 1.f };
+
+        const auto quantize = [](float value, float minValue, float scale)
+        { return static_cast<uint16_t>(std::clamp(std::lround((value - minValue) / scale), 0l, static_cast<long>(UINT16_MAX))); };
+
+        compactStorage.positionX.assign(objectVertices.GetPaddedSize(), 0);
+        compactStorage.positionY.assign(objectVertices.GetPaddedSize(), 0);
+        compactStorage.positionZ.assign(objectVertices.GetPaddedSize(), 0);
+        const Vector3& scale{ compactStorage.positionScale };
+        for(size_t vertexIdx{}; vertexIdx < vertices.size(); ++vertexIdx)
+        {
+            compactStorage.positionX[vertexIdx] = quantize(vertices[vertexIdx].x, minObjectAABB.x, scale.x);
+            compactStorage.positionY[vertexIdx] = quantize(vertices[vertexIdx].y, minObjectAABB.y, scale.y);
+            compactStorage.positionZ[vertexIdx] = quantize(vertices[vertexIdx].z, minObjectAABB.z, scale.z);
+        }
+        ReleaseStorage(objectVertices);
+    }
+
+    compactStorage.normals.resize(normals.size());
+    std::transform(normals.begin(), normals.end(), compactStorage.normals.begin(), CompactMeshStorage::EncodeNormal);
+
+    if(vertices.size() <= size_t{ UINT16_MAX } + 1)
+    {
+        compactStorage.indices.resize(indices.size());
+        std::transform(indices.begin(), indices.end(), compactStorage.indices.begin(),
+                       [](int index) { return static_cast<uint16_t>(index); });
+        ReleaseStorage(indices);
+    }
+
+    ReleaseStorage(vertices);
+    ReleaseStorage(normals);
+    ReleaseStorage(objectNormals);
+    ReleaseStorage(transformedNormals);
+
+    isCompact = true;
+    isTransformDirty = true;
+}
+
+void TriangleMesh::UpdateTransformedAABB(const Matrix& finalTransform)
+{
+    // The 8 corners fill exactly one batch of the transform kernel
+    alignas(32) float cornersX[VertexStream::BATCH_SIZE]{ minObjectAABB.x, maxObjectAABB.x, maxObjectAABB.x, minObjectAABB.x,
+                                                          minObjectAABB.x, maxObjectAABB.x, maxObjectAABB.x, minObjectAABB.x };
+    alignas(32) float cornersY[VertexStream::BATCH_SIZE]{ minObjectAABB.y, minObjectAABB.y, minObjectAABB.y, minObjectAABB.y,
+                                                          maxObjectAABB.y, maxObjectAABB.y, maxObjectAABB.y, maxObjectAABB.y };
+    alignas(32) float cornersZ[VertexStream::BATCH_SIZE]{ minObjectAABB.z, minObjectAABB.z, maxObjectAABB.z, maxObjectAABB.z,
+                                                          minObjectAABB.z, minObjectAABB.z, maxObjectAABB.z, maxObjectAABB.z };
+    finalTransform.TransformPoints(cornersX, cornersY, cornersZ, cornersX, cornersY, cornersZ, VertexStream::BATCH_SIZE);
+
+    minWorldAABB = { cornersX[0], cornersY[0], cornersZ[0] };
+    maxWorldAABB = minWorldAABB;
+    for(size_t cornerIdx{ 1 }; cornerIdx < VertexStream::BATCH_SIZE; ++cornerIdx)
+    {
+        const Vector3 corner{ cornersX[cornerIdx], cornersY[cornerIdx], cornersZ[cornerIdx] };
+        minWorldAABB = Vector3::Min(corner, minWorldAABB);
+        maxWorldAABB = Vector3::Max(corner, maxWorldAABB);
+    }
+}
+}  // namespace dae
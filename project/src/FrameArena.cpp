@@ -0,0 +1,44 @@
+#include "FrameArena.hpp"
+
+#include <algorithm>
+
+namespace dae
+{
+FrameArena& FrameArena::GetThreadArena()
+{
+    thread_local FrameArena arena{};
+
+    const uint64_t frameIdx{ s_FrameIdx.load(std::memory_order_relaxed) };
+    if(arena.m_FrameIdx != frameIdx)
+    {
+        arena.Rewind();
+        arena.m_FrameIdx = frameIdx;
+    }
+    return arena;
+}
+
+void* FrameArena::Allocate(size_t size, size_t alignment)
+{
+    // Continue in the current block, then in the blocks kept from earlier frames, grow only when none fits
+    for(; m_BlockIdx < m_Blocks.size(); ++m_BlockIdx, m_Offset = 0)
+    {
+        Block& block{ m_Blocks[m_BlockIdx] };
+        const uintptr_t address{ reinterpret_cast<uintptr_t>(block.pData.get()) + m_Offset };
+        const size_t alignedOffset{ m_Offset + ((alignment - (address % alignment)) % alignment) };
+        if(alignedOffset + size <= block.size)
+        {
+            m_Offset = alignedOffset + size;
+            return block.pData.get() + alignedOffset;
+        }
+    }
+
+    // new[] only guarantees fundamental alignment, over-allocate so any alignment fits
+    const size_t blockSize{ std::max(DEFAULT_BLOCK_SIZE, size + alignment) };
+    // A heap allocation like any other, so the allocation profiler's steady-state assertion also catches arenas that keep growing
+    m_Blocks.push_back({ .pData = std::make_unique_for_overwrite<std::byte[]>(blockSize), .size = blockSize });
+
+    m_BlockIdx = m_Blocks.size() - 1;
+    m_Offset = 0;
+    return Allocate(size, alignment);
+}
+}  // namespace dae
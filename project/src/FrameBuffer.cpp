@@ -0,0 +1,295 @@
+#include "FrameBuffer.hpp"
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <execution>
+#include <numeric>
+
+#include "SDL_endian.h"
+#include "SDL_surface.h"
+
+#if defined(__AVX2__)
+#include <immintrin.h>
+#endif
+
+namespace dae
+{
+namespace
+{
+// 4x4 ordered dithering thresholds
+constexpr uint32_t BAYER_MATRIX[4][4]{ { 0, 8, 2, 10 }, { 12, 4, 14, 6 }, { 3, 11, 1, 9 }, { 15, 7, 13, 5 } };
+
+// Scale from [0, 1] to an 8-bit value in 8.8 fixed point
+constexpr float FIXED_POINT_SCALE{ 255.f * 256.f };
+
+float LinearToSRGB(float linear)
+{
+    if(linear <= 0.0031308f)
+        return linear * 12.92f;
+    return (1.055f * std::pow(linear, 1.f / 2.4f)) - 0.055f;
+}
+
+#if defined(__AVX2__)
+template<FrameBuffer::ToneMappingOperator toneMappingOperator>
+__m256 ToneMap8(__m256 value, __m256 maxValue, __m256 exposure)
+{
+    const __m256 one{ _mm256_set1_ps(1.f) };
+    const __m256 zero{ _mm256_setzero_ps() };
+
+    if constexpr(toneMappingOperator == FrameBuffer::ToneMappingOperator::MaxToOne)
+    {
+        // Dividing by 1 leaves in-range colors untouched
+        value = _mm256_div_ps(value, _mm256_max_ps(maxValue, one));
+    }
+    else if constexpr(toneMappingOperator == FrameBuffer::ToneMappingOperator::Exposure)
+    {
+        value = _mm256_mul_ps(value, exposure);
+    }
+    else if constexpr(toneMappingOperator == FrameBuffer::ToneMappingOperator::Reinhard)
+    {
+        value = _mm256_max_ps(_mm256_mul_ps(value, exposure), zero);
+        value = _mm256_div_ps(value, _mm256_add_ps(value, one));
+    }
+    else if constexpr(toneMappingOperator == FrameBuffer::ToneMappingOperator::ACES)
+    {
+        value = _mm256_mul_ps(value, exposure);
+        const __m256 numerator{ _mm256_mul_ps(value, _mm256_fmadd_ps(value, _mm256_set1_ps(2.51f), _mm256_set1_ps(0.03f))) };
+        const __m256 denominator{ _mm256_fmadd_ps(value, _mm256_fmadd_ps(value, _mm256_set1_ps(2.43f), _mm256_set1_ps(0.59f)),
+                                                  _mm256_set1_ps(0.14f)) };
+        value = _mm256_div_ps(numerator, denominator);
+    }
+
+    return _mm256_min_ps(_mm256_max_ps(value, zero), one);
+}
+#endif
+}  // namespace
+
+FrameBuffer::FrameBuffer(int width, int height)
+    : m_Width(width)
+    , m_Height(height)
+    , m_Red(static_cast<size_t>(width * height))
+    , m_Green(static_cast<size_t>(width * height))
+    , m_Blue(static_cast<size_t>(width * height))
+{
+    m_RowIndices.resize(height);
+    std::iota(m_RowIndices.begin(), m_RowIndices.end(), 0);
+
+    BuildTransferLUT();
+}
+
+void FrameBuffer::SetTransferFunction(TransferFunction transferFunction)
+{
+    m_TransferFunction = transferFunction;
+    BuildTransferLUT();
+}
+
+void FrameBuffer::SetGamma(float gamma)
+{
+    m_Gamma = gamma;
+    SetTransferFunction(TransferFunction::Gamma);
+}
+
+void FrameBuffer::BuildTransferLUT()
+{
+    m_TransferLUT.resize(TRANSFER_LUT_SIZE);
+    for(int i{}; i < TRANSFER_LUT_SIZE; ++i)
+    {
+        const float linear{ static_cast<float>(i) / static_cast<float>(TRANSFER_LUT_SIZE - 1) };
+
+        float encoded{ linear };
+        if(m_TransferFunction == TransferFunction::Gamma)
+            encoded = std::pow(linear, 1.f / m_Gamma);
+        else if(m_TransferFunction == TransferFunction::SRGB)
+            encoded = LinearToSRGB(linear);
+
+        m_TransferLUT[i] = static_cast<int32_t>(encoded * FIXED_POINT_SCALE);
+    }
+}
+
+void FrameBuffer::Resolve(SDL_Surface* pSurface) const
+{
+    switch(m_ToneMappingOperator)
+    {
+        case ToneMappingOperator::Exposure:
+            ResolveRows<ToneMappingOperator::Exposure>(pSurface);
+            break;
+        case ToneMappingOperator::Reinhard:
+            ResolveRows<ToneMappingOperator::Reinhard>(pSurface);
+            break;
+        case ToneMappingOperator::ACES:
+            ResolveRows<ToneMappingOperator::ACES>(pSurface);
+            break;
+        case ToneMappingOperator::MaxToOne:
+        case ToneMappingOperator::Count:
+            ResolveRows<ToneMappingOperator::MaxToOne>(pSurface);
+            break;
+    }
+}
+
+template<FrameBuffer::ToneMappingOperator toneMappingOperator>
+void FrameBuffer::ResolveRows(SDL_Surface* pSurface) const
+{
+    const SDL_PixelFormat* pFormat{ pSurface->format };
+    auto* const pPixels{ static_cast<uint8_t*>(pSurface->pixels) };
+
+    // Every 8-bit per channel 32-bit format can be packed with shifts, anything else is mapped per pixel by SDL and written
+    // with the surface's own pixel size
+    const bool isPacked32{ pFormat->BytesPerPixel == 4 and pFormat->Rloss == 0 and pFormat->Gloss == 0 and
+                           pFormat->Bloss == 0 };
+    const PixelPacking packing{ .rShift = pFormat->Rshift,
+                                .gShift = pFormat->Gshift,
+                                .bShift = pFormat->Bshift,
+                                .alphaMask = pFormat->Amask };
+
+    std::for_each(std::execution::par, m_RowIndices.begin(), m_RowIndices.end(),
+                  [&](const int row)
+                  {
+                      uint8_t* const pRow{ pPixels + (static_cast<ptrdiff_t>(row) * pSurface->pitch) };
+                      if(isPacked32)
+                          ResolveRow<toneMappingOperator>(row, reinterpret_cast<uint32_t*>(pRow), packing);
+                      else
+                          ResolveRowMapped<toneMappingOperator>(row, pRow, pSurface);
+                  });
+}
+
+template<FrameBuffer::ToneMappingOperator toneMappingOperator>
+void FrameBuffer::ResolveRow(int row, uint32_t* pRow, const PixelPacking& packing) const
+{
+    const float* const pRed{ m_Red.data() + (static_cast<ptrdiff_t>(row) * m_Width) };
+    const float* const pGreen{ m_Green.data() + (static_cast<ptrdiff_t>(row) * m_Width) };
+    const float* const pBlue{ m_Blue.data() + (static_cast<ptrdiff_t>(row) * m_Width) };
+
+    int px{};
+
+#if defined(__AVX2__)
+    const bool isLinear{ m_TransferFunction == TransferFunction::Linear };
+    const __m256 exposure{ _mm256_set1_ps(m_Exposure) };
+    const __m256 scale{ _mm256_set1_ps(isLinear ? FIXED_POINT_SCALE : static_cast<float>(TRANSFER_LUT_SIZE - 1)) };
+    const __m256i maxEncoded{ _mm256_set1_epi32(255) };
+    const __m128i rShift{ _mm_cvtsi32_si128(static_cast<int>(packing.rShift)) };
+    const __m128i gShift{ _mm_cvtsi32_si128(static_cast<int>(packing.gShift)) };
+    const __m128i bShift{ _mm_cvtsi32_si128(static_cast<int>(packing.bShift)) };
+    const __m256i alpha{ _mm256_set1_epi32(static_cast<int>(packing.alphaMask)) };
+
+    // The dither pattern repeats every 4 pixels, so one register covers every 8-pixel block of the row
+    const __m256i ditherOffset{ _mm256_setr_epi32(
+        static_cast<int>(GetDitherOffset(0, row)), static_cast<int>(GetDitherOffset(1, row)),
+        static_cast<int>(GetDitherOffset(2, row)), static_cast<int>(GetDitherOffset(3, row)),
+        static_cast<int>(GetDitherOffset(0, row)), static_cast<int>(GetDitherOffset(1, row)),
+        static_cast<int>(GetDitherOffset(2, row)), static_cast<int>(GetDitherOffset(3, row))) };
+
+    auto encode = [&](__m256 value) -> __m256i
+    {
+        __m256i fixedPoint{ _mm256_cvttps_epi32(_mm256_mul_ps(value, scale)) };
+        if(not isLinear)
+            fixedPoint = _mm256_i32gather_epi32(m_TransferLUT.data(), fixedPoint, 4);
+
+        return _mm256_min_epi32(_mm256_srli_epi32(_mm256_add_epi32(fixedPoint, ditherOffset), 8), maxEncoded);
+    };
+
+    for(; px + 8 <= m_Width; px += 8)
+    {
+        const __m256 red{ _mm256_loadu_ps(pRed + px) };
+        const __m256 green{ _mm256_loadu_ps(pGreen + px) };
+        const __m256 blue{ _mm256_loadu_ps(pBlue + px) };
+        const __m256 maxValue{ _mm256_max_ps(_mm256_max_ps(red, green), blue) };
+
+        const __m256i redBits{ encode(ToneMap8<toneMappingOperator>(red, maxValue, exposure)) };
+        const __m256i greenBits{ encode(ToneMap8<toneMappingOperator>(green, maxValue, exposure)) };
+        const __m256i blueBits{ encode(ToneMap8<toneMappingOperator>(blue, maxValue, exposure)) };
+
+        const __m256i packed{ _mm256_or_si256(
+            _mm256_or_si256(_mm256_sll_epi32(redBits, rShift), _mm256_sll_epi32(greenBits, gShift)),
+            _mm256_or_si256(_mm256_sll_epi32(blueBits, bShift), alpha)) };
+        _mm256_storeu_si256(reinterpret_cast<__m256i*>(pRow + px), packed);
+    }
+#endif
+
+    for(; px < m_Width; ++px)
+    {
+        const ColorRGB color{ ToneMap<toneMappingOperator>({ .r = pRed[px], .g = pGreen[px], .b = pBlue[px] }) };
+        const uint32_t ditherOffset{ GetDitherOffset(px, row) };
+
+        pRow[px] = (EncodeChannel(color.r, ditherOffset) << packing.rShift) |
+            (EncodeChannel(color.g, ditherOffset) << packing.gShift) | (EncodeChannel(color.b, ditherOffset) << packing.bShift) |
+            packing.alphaMask;
+    }
+}
+
+template<FrameBuffer::ToneMappingOperator toneMappingOperator>
+void FrameBuffer::ResolveRowMapped(int row, uint8_t* pRow, const SDL_Surface* pSurface) const
+{
+    // SDL stores a pixel as the low BytesPerPixel bytes of the mapped value in native byte order
+    const size_t bytesPerPixel{ pSurface->format->BytesPerPixel };
+#if SDL_BYTEORDER == SDL_BIG_ENDIAN
+    const size_t valueOffset{ sizeof(uint32_t) - bytesPerPixel };
+#else
+    const size_t valueOffset{};
+#endif
+
+    for(int px{}; px < m_Width; ++px)
+    {
+        const ColorRGB color{ ToneMap<toneMappingOperator>(GetPixel(px + (row * m_Width))) };
+        const uint32_t ditherOffset{ GetDitherOffset(px, row) };
+
+        const uint32_t pixel{ SDL_MapRGB(pSurface->format, static_cast<uint8_t>(EncodeChannel(color.r, ditherOffset)),
+                                         static_cast<uint8_t>(EncodeChannel(color.g, ditherOffset)),
+                                         static_cast<uint8_t>(EncodeChannel(color.b, ditherOffset))) };
+        std::memcpy(pRow + (px * bytesPerPixel), reinterpret_cast<const uint8_t*>(&pixel) + valueOffset, bytesPerPixel);
+    }
+}
+
+template<FrameBuffer::ToneMappingOperator toneMappingOperator>
+ColorRGB FrameBuffer::ToneMap(const ColorRGB& color) const
+{
+    ColorRGB mapped{ color };
+    auto toneMapChannel = [this](float value) -> float
+    {
+        value *= m_Exposure;
+        if constexpr(toneMappingOperator == ToneMappingOperator::Reinhard)
+        {
+            value = std::max(value, 0.f);
+            value /= value + 1.f;
+        }
+        else if constexpr(toneMappingOperator == ToneMappingOperator::ACES)
+        {
+            value = (value * ((2.51f * value) + 0.03f)) / ((value * ((2.43f * value) + 0.59f)) + 0.14f);
+        }
+        return value;
+    };
+
+    if constexpr(toneMappingOperator == ToneMappingOperator::MaxToOne)
+    {
+        mapped.MaxToOne();
+    }
+    else
+    {
+        mapped.r = toneMapChannel(mapped.r);
+        mapped.g = toneMapChannel(mapped.g);
+        mapped.b = toneMapChannel(mapped.b);
+    }
+
+    return { .r = Saturate(mapped.r), .g = Saturate(mapped.g), .b = Saturate(mapped.b) };
+}
+
+uint32_t FrameBuffer::EncodeChannel(float value, uint32_t ditherOffset) const
+{
+    uint32_t fixedPoint{};
+    if(m_TransferFunction == TransferFunction::Linear)
+        fixedPoint = static_cast<uint32_t>(value * FIXED_POINT_SCALE);
+    else
+        fixedPoint = static_cast<uint32_t>(m_TransferLUT[static_cast<int>(value * static_cast<float>(TRANSFER_LUT_SIZE - 1))]);
+
+    return std::min((fixedPoint + ditherOffset) >> 8, 255u);
+}
+
+uint32_t FrameBuffer::GetDitherOffset(int px, int row) const
+{
+    if(m_DitheringEnabled)
+        return (BAYER_MATRIX[row & 3][px & 3] * 16) + 8;
+
+    // Linear output truncates like a plain float to 8-bit cast, the lookup table rounds to nearest
+    return m_TransferFunction == TransferFunction::Linear ? 0 : 128;
+}
+}  // namespace dae
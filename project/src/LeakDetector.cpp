@@ -4,6 +4,14 @@
 // Authors: Matthieu Delaere
 // ---------------------------------------------
 #include "LeakDetector.hpp"
+
+#include <atomic>
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+#include <mutex>
+#include <new>
 using namespace dae;
 
 #if (defined(_WIN32) || defined(_WIN64)) && defined(_DEBUG)
@@ -34,3 +42,210 @@ void LeakDetector::BreakOnAllocationId(int) {}
 void LeakDetector::CheckForLeaks() {}
 
 #endif
+
+//--- Allocation Profiling ---
+#if defined(ALLOCATION_PROFILER_ENABLED)
+namespace
+{
+    constexpr int g_max_allocation_tags = 32;
+
+    struct AllocationCounter
+    {
+        std::atomic<uint64_t> allocations{};
+        std::atomic<uint64_t> bytes{};
+    };
+
+    struct AllocationTotals
+    {
+        uint64_t allocations{};
+        uint64_t bytes{};
+    };
+
+    // Tag 0 collects everything allocated outside an AllocationTag
+    const char* g_tag_names[g_max_allocation_tags]{ "untagged" };
+    AllocationCounter g_counters[g_max_allocation_tags]{};
+    std::atomic<int> g_tag_count{ 1 };
+    std::atomic<int> g_current_tag{ 0 };
+    std::mutex g_tag_mutex{};
+
+    // Only touched by the thread running the frame loop
+    AllocationTotals g_frame_start[g_max_allocation_tags]{};
+    AllocationTotals g_report_totals[g_max_allocation_tags]{};
+    int g_report_frames = 0;
+    int g_frame_idx = 0;
+    int g_assert_after_frame = -1;
+
+    void CountAllocation(std::size_t size)
+    {
+        AllocationCounter& counter = g_counters[g_current_tag.load(std::memory_order_relaxed)];
+        counter.allocations.fetch_add(1, std::memory_order_relaxed);
+        counter.bytes.fetch_add(size, std::memory_order_relaxed);
+    }
+
+    int FindOrAddTag(const char* name)
+    {
+        const std::lock_guard lock{ g_tag_mutex };
+        const int tag_count = g_tag_count.load(std::memory_order_relaxed);
+        for(int tag_id = 1; tag_id < tag_count; ++tag_id)
+        {
+            if(std::strcmp(g_tag_names[tag_id], name) == 0)
+                return tag_id;
+        }
+
+        // Out of slots, count it as untagged rather than dropping it
+        if(tag_count == g_max_allocation_tags)
+            return 0;
+
+        g_tag_names[tag_count] = name;
+        g_tag_count.store(tag_count + 1, std::memory_order_relaxed);
+        return tag_count;
+    }
+
+    void* AllocateAligned(std::size_t size, std::size_t alignment)
+    {
+#if defined(_WIN32) || defined(_WIN64)
+        return _aligned_malloc(size != 0 ? size : 1, alignment);
+#else
+        // aligned_alloc wants a size that is a multiple of the alignment
+        return aligned_alloc(alignment, ((size + alignment - 1) / alignment) * alignment);
+#endif
+    }
+
+    void FreeAligned(void* pointer)
+    {
+#if defined(_WIN32) || defined(_WIN64)
+        _aligned_free(pointer);
+#else
+        free(pointer);
+#endif
+    }
+}
+
+// Replacing the global operators is what makes the counts work in release builds and on every platform.
+// The nothrow and array forms all forward to these. The sized deletes are replaced too, the set has to be complete.
+void* operator new(std::size_t size)
+{
+    CountAllocation(size);
+    if(void* pointer = malloc(size != 0 ? size : 1))
+        return pointer;
+    throw std::bad_alloc{};
+}
+
+void* operator new(std::size_t size, std::align_val_t alignment)
+{
+    CountAllocation(size);
+    if(void* pointer = AllocateAligned(size, static_cast<std::size_t>(alignment)))
+        return pointer;
+    throw std::bad_alloc{};
+}
+
+void operator delete(void* pointer) noexcept
+{
+    free(pointer);
+}
+
+void operator delete(void* pointer, std::align_val_t) noexcept
+{
+    FreeAligned(pointer);
+}
+
+void operator delete(void* pointer, std::size_t) noexcept
+{
+    free(pointer);
+}
+
+void operator delete(void* pointer, std::size_t, std::align_val_t) noexcept
+{
+    FreeAligned(pointer);
+}
+
+LeakDetector::AllocationTag::AllocationTag(const char* name)
+    : m_PreviousTagId{ g_current_tag.exchange(FindOrAddTag(name), std::memory_order_relaxed) }
+{
+}
+
+LeakDetector::AllocationTag::~AllocationTag()
+{
+    g_current_tag.store(m_PreviousTagId, std::memory_order_relaxed);
+}
+
+void LeakDetector::BeginFrame()
+{
+    for(int tag_id = 0; tag_id < g_tag_count.load(std::memory_order_relaxed); ++tag_id)
+    {
+        g_frame_start[tag_id] = { g_counters[tag_id].allocations.load(std::memory_order_relaxed),
+                                  g_counters[tag_id].bytes.load(std::memory_order_relaxed) };
+    }
+}
+
+void LeakDetector::EndFrame()
+{
+    uint64_t frame_allocations = 0;
+    for(int tag_id = 0; tag_id < g_tag_count.load(std::memory_order_relaxed); ++tag_id)
+    {
+        const AllocationCounter& counter = g_counters[tag_id];
+        const uint64_t allocations = counter.allocations.load(std::memory_order_relaxed) - g_frame_start[tag_id].allocations;
+        const uint64_t bytes = counter.bytes.load(std::memory_order_relaxed) - g_frame_start[tag_id].bytes;
+        g_report_totals[tag_id].allocations += allocations;
+        g_report_totals[tag_id].bytes += bytes;
+        frame_allocations += allocations;
+    }
+    ++g_report_frames;
+
+    if(g_assert_after_frame >= 0 && g_frame_idx >= g_assert_after_frame && frame_allocations > 0)
+    {
+        std::cerr << "Frame " << g_frame_idx << " allocated " << frame_allocations << " times after warm-up\n";
+        PrintAllocationReport(std::cerr);
+        std::abort();
+    }
+    ++g_frame_idx;
+}
+
+void LeakDetector::PrintAllocationReport(std::ostream& os)
+{
+    AllocationTotals total{};
+    for(int tag_id = 0; tag_id < g_tag_count.load(std::memory_order_relaxed); ++tag_id)
+    {
+        total.allocations += g_report_totals[tag_id].allocations;
+        total.bytes += g_report_totals[tag_id].bytes;
+    }
+
+    os << "Heap: " << total.allocations << " allocations, " << total.bytes << " bytes over " << g_report_frames
+       << " frames\n";
+    for(int tag_id = 0; tag_id < g_tag_count.load(std::memory_order_relaxed); ++tag_id)
+    {
+        if(g_report_totals[tag_id].allocations == 0)
+            continue;
+
+        os << "    " << g_tag_names[tag_id] << ": " << g_report_totals[tag_id].allocations << " allocations, "
+           << g_report_totals[tag_id].bytes << " bytes\n";
+        g_report_totals[tag_id] = {};
+    }
+    g_report_frames = 0;
+}
+
+bool LeakDetector::EnableAllocationAssertion(int warmupFrames)
+{
+    g_assert_after_frame = g_frame_idx + warmupFrames;
+    return true;
+}
+
+#else
+
+LeakDetector::AllocationTag::AllocationTag(const char*) {}
+
+LeakDetector::AllocationTag::~AllocationTag() = default;
+
+void LeakDetector::BeginFrame() {}
+
+void LeakDetector::EndFrame() {}
+
+void LeakDetector::PrintAllocationReport(std::ostream&) {}
+
+bool LeakDetector::EnableAllocationAssertion(int)
+{
+    std::cerr << "Allocation assertion requested, but the allocation profiler is not built in (ALLOCATION_PROFILER_ENABLED)\n";
+    return false;
+}
+
+#endif
@@ -0,0 +1,133 @@
+#include "LightGrid.hpp"
+
+#include <algorithm>
+#include <cfloat>
+#include <cmath>
+
+#include "Utils.hpp"
+
+namespace dae
+{
+void LightGrid::Build(const std::vector<Light>& lights, float threshold)
+{
+    m_Threshold = threshold;
+    m_UnboundedLights.clear();
+    m_CellOffsets.clear();
+    m_CellLights.clear();
+    m_LightOrigins.resize(lights.size());
+    m_InfluenceRadiiSquared.resize(lights.size());
+
+    std::vector<uint32_t> boundedLights;
+    Vector3 boundsMax{};
+    for(uint32_t lightIdx{}; lightIdx < lights.size(); ++lightIdx)
+    {
+        const Light& light{ lights[lightIdx] };
+        const float radius{ LightUtils::GetInfluenceRadius(light, threshold) };
+        m_LightOrigins[lightIdx] = light.origin;
+        m_InfluenceRadiiSquared[lightIdx] = radius == FLT_MAX ? FLT_MAX : radius * radius;
+
+        if(radius == FLT_MAX)
+        {
+            m_UnboundedLights.push_back(lightIdx);
+            continue;
+        }
+
+        // Black or zero intensity lights never contribute
+        if(radius <= 0.f)
+            continue;
+
+        const Vector3 extent{ radius, radius, radius };
+        if(boundedLights.empty())
+        {
+            m_BoundsMin = light.origin - extent;
+            boundsMax = light.origin + extent;
+        }
+        m_BoundsMin = Vector3::Min(m_BoundsMin, light.origin - extent);
+        boundsMax = Vector3::Max(boundsMax, light.origin + extent);
+        boundedLights.push_back(lightIdx);
+    }
+
+    if(boundedLights.empty())
+    {
+        m_CellCount[0] = m_CellCount[1] = m_CellCount[2] = 0;
+        return;
+    }
+
+    // Cubic-ish cells, the longest axis gets MAX_CELLS_PER_AXIS of them
+    const Vector3 size{ boundsMax - m_BoundsMin };
+    const float cellSize{ std::max({ size.x, size.y, size.z }) / static_cast<float>(MAX_CELLS_PER_AXIS) };
+    for(int axis{}; axis < 3; ++axis)
+    {
+        m_CellCount[axis] = std::clamp(static_cast<int>(std::ceil(size[axis] / cellSize)), 1, MAX_CELLS_PER_AXIS);
+        m_CellSize[axis] = size[axis] / static_cast<float>(m_CellCount[axis]);
+    }
+
+    // Bin every light into the cells its sphere overlaps, then flatten the lists
+    std::vector<std::vector<uint32_t>> cells(static_cast<size_t>(m_CellCount[0] * m_CellCount[1] * m_CellCount[2]));
+    for(const uint32_t lightIdx : boundedLights)
+    {
+        const Vector3& origin{ m_LightOrigins[lightIdx] };
+        const float radiusSquared{ m_InfluenceRadiiSquared[lightIdx] };
+
+        int firstCell[3]{};
+        int lastCell[3]{};
+        for(int axis{}; axis < 3; ++axis)
+        {
+            const float radius{ std::sqrt(radiusSquared) };
+            firstCell[axis] = std::clamp(static_cast<int>((origin[axis] - radius - m_BoundsMin[axis]) / m_CellSize[axis]), 0,
+                                         m_CellCount[axis] - 1);
+            lastCell[axis] = std::clamp(static_cast<int>((origin[axis] + radius - m_BoundsMin[axis]) / m_CellSize[axis]), 0,
+                                        m_CellCount[axis] - 1);
+        }
+
+        for(int z{ firstCell[2] }; z <= lastCell[2]; ++z)
+        {
+            for(int y{ firstCell[1] }; y <= lastCell[1]; ++y)
+            {
+                for(int x{ firstCell[0] }; x <= lastCell[0]; ++x)
+                {
+                    // Squared distance from the light to the closest point of the cell
+                    const Vector3 cellMin{ m_BoundsMin.x + (static_cast<float>(x) * m_CellSize.x),
+                                           m_BoundsMin.y + (static_cast<float>(y) * m_CellSize.y),
+                                           m_BoundsMin.z + (static_cast<float>(z) * m_CellSize.z) };
+                    const Vector3 closest{ Vector3::Max(cellMin, Vector3::Min(origin, cellMin + m_CellSize)) };
+                    if((closest - origin).SqrMagnitude() <= radiusSquared)
+                        cells[GetCellIndex(x, y, z)].push_back(lightIdx);
+                }
+            }
+        }
+    }
+
+    m_CellOffsets.reserve(cells.size() + 1);
+    m_CellOffsets.push_back(0);
+    for(const std::vector<uint32_t>& cell : cells)
+    {
+        m_CellLights.insert(m_CellLights.end(), cell.begin(), cell.end());
+        m_CellOffsets.push_back(static_cast<uint32_t>(m_CellLights.size()));
+    }
+}
+
+std::span<const uint32_t> LightGrid::GetLights(const Vector3& position) const
+{
+    if(m_CellOffsets.empty())
+        return {};
+
+    int cell[3]{};
+    for(int axis{}; axis < 3; ++axis)
+    {
+        const float local{ (position[axis] - m_BoundsMin[axis]) / m_CellSize[axis] };
+        if(local < 0.f or local >= static_cast<float>(m_CellCount[axis]))
+            return {};
+
+        cell[axis] = static_cast<int>(local);
+    }
+
+    const int cellIdx{ GetCellIndex(cell[0], cell[1], cell[2]) };
+    return { m_CellLights.data() + m_CellOffsets[cellIdx], m_CellLights.data() + m_CellOffsets[cellIdx + 1] };
+}
+
+bool LightGrid::IsInRange(uint32_t lightIdx, const Vector3& position) const
+{
+    return (position - m_LightOrigins[lightIdx]).SqrMagnitude() <= m_InfluenceRadiiSquared[lightIdx];
+}
+}  // namespace dae
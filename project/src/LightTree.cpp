@@ -0,0 +1,136 @@
+#include "LightTree.hpp"
+
+#include <algorithm>
+
+#include "Utils.hpp"
+
+namespace dae
+{
+void LightTree::Build(const std::vector<Light>& lights)
+{
+    m_Nodes.clear();
+    m_DirectionalLights.clear();
+    m_BuiltLightCount = lights.size();
+
+    std::vector<uint32_t> pointLights;
+    for(uint32_t lightIdx{}; lightIdx < lights.size(); ++lightIdx)
+    {
+        if(lights[lightIdx].type == LightType::Directional)
+            m_DirectionalLights.push_back(lightIdx);
+        else
+            pointLights.push_back(lightIdx);
+    }
+
+    if(pointLights.empty())
+        return;
+
+    m_Nodes.reserve((2 * pointLights.size()) - 1);
+    BuildNode(lights, pointLights, 0, pointLights.size());
+}
+
+bool LightTree::Sample(const Vector3& origin, const Vector3& normal, float u, LightSample& sample) const
+{
+    if(m_Nodes.empty())
+        return false;
+
+    float pdf{ 1.f };
+    const Node* pNode{ &m_Nodes.front() };
+    while(not pNode->isLeaf)
+    {
+        const float leftImportance{ GetImportance(m_Nodes[pNode->leftChild], origin, normal) };
+        const float rightImportance{ GetImportance(m_Nodes[pNode->rightChild], origin, normal) };
+        const float totalImportance{ leftImportance + rightImportance };
+        if(totalImportance <= 0.f)
+            return false;
+
+        const float leftProbability{ leftImportance / totalImportance };
+        if(u < leftProbability)
+        {
+            u = std::min(u / leftProbability, 0.99999994f);
+            pdf *= leftProbability;
+            pNode = &m_Nodes[pNode->leftChild];
+        }
+        else
+        {
+            u = std::min((u - leftProbability) / (1.f - leftProbability), 0.99999994f);
+            pdf *= 1.f - leftProbability;
+            pNode = &m_Nodes[pNode->rightChild];
+        }
+    }
+
+    // A lone root leaf was never weighed against a sibling
+    if(GetImportance(*pNode, origin, normal) <= 0.f)
+        return false;
+
+    sample = { .lightIndex = pNode->lightIndex, .pdf = pdf };
+    return true;
+}
+
+uint32_t LightTree::BuildNode(const std::vector<Light>& lights, std::vector<uint32_t>& lightIndices, size_t begin, size_t end)
+{
+    const auto nodeIdx{ static_cast<uint32_t>(m_Nodes.size()) };
+    m_Nodes.emplace_back();
+
+    Vector3 boundsMin{ lights[lightIndices[begin]].origin };
+    Vector3 boundsMax{ boundsMin };
+    float power{};
+    for(size_t idx{ begin }; idx < end; ++idx)
+    {
+        // Area lights are bounded by their whole emitter, a point that only sees its edge still gets to pick it
+        const Light& light{ lights[lightIndices[idx]] };
+        const float lightExtent{ LightUtils::GetLightExtent(light) };
+        const Vector3 extent{ lightExtent, lightExtent, lightExtent };
+        boundsMin = Vector3::Min(boundsMin, light.origin - extent);
+        boundsMax = Vector3::Max(boundsMax, light.origin + extent);
+        power += light.intensity * (light.color.r + light.color.g + light.color.b) / 3.f;
+    }
+
+    if(end - begin == 1)
+    {
+        m_Nodes[nodeIdx] = { .boundsMin = boundsMin,
+                             .boundsMax = boundsMax,
+                             .power = power,
+                             .lightIndex = lightIndices[begin],
+                             .isLeaf = true };
+        return nodeIdx;
+    }
+
+    // Median split along the longest axis of the bounds
+    const Vector3 extent{ boundsMax - boundsMin };
+    const int axis{ extent.x >= extent.y and extent.x >= extent.z ? 0 : (extent.y >= extent.z ? 1 : 2) };
+    const size_t middle{ begin + ((end - begin) / 2) };
+    std::nth_element(lightIndices.begin() + static_cast<std::ptrdiff_t>(begin),
+                     lightIndices.begin() + static_cast<std::ptrdiff_t>(middle),
+                     lightIndices.begin() + static_cast<std::ptrdiff_t>(end),
+                     [&](uint32_t a, uint32_t b) { return lights[a].origin[axis] < lights[b].origin[axis]; });
+
+    const uint32_t leftChild{ BuildNode(lights, lightIndices, begin, middle) };
+    const uint32_t rightChild{ BuildNode(lights, lightIndices, middle, end) };
+    m_Nodes[nodeIdx] = {
+        .boundsMin = boundsMin, .boundsMax = boundsMax, .power = power, .leftChild = leftChild, .rightChild = rightChild
+    };
+    return nodeIdx;
+}
+
+float LightTree::GetImportance(const Node& node, const Vector3& origin, const Vector3& normal) const
+{
+    // Nothing to gain from a subtree that lies entirely behind the surface
+    bool isAboveSurface{ false };
+    for(int corner{}; corner < 8 and not isAboveSurface; ++corner)
+    {
+        const Vector3 cornerPosition{ (corner & 1) ? node.boundsMax.x : node.boundsMin.x,
+                                      (corner & 2) ? node.boundsMax.y : node.boundsMin.y,
+                                      (corner & 4) ? node.boundsMax.z : node.boundsMin.z };
+        isAboveSurface = Vector3::Dot(cornerPosition - origin, normal) > 0.f;
+    }
+    if(not isAboveSurface)
+        return 0.f;
+
+    // Power over squared distance to the center, clamped to the bounds radius so the shading points inside a
+    // cluster don't overweight it
+    const Vector3 center{ (node.boundsMin + node.boundsMax) * 0.5f };
+    const float radiusSqr{ (node.boundsMax - center).SqrMagnitude() };
+    const float distanceSqr{ std::max({ (center - origin).SqrMagnitude(), radiusSqr, 0.0001f }) };
+    return node.power / distanceSqr;
+}
+}  // namespace dae
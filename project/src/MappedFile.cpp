@@ -0,0 +1,75 @@
+#include "MappedFile.hpp"
+
+#if defined(_WIN32) || defined(_WIN64)
+#define WIN32_LEAN_AND_MEAN
+#define NOMINMAX
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+namespace dae
+{
+#if defined(_WIN32) || defined(_WIN64)
+MappedFile::MappedFile(const std::filesystem::path& path)
+{
+    HANDLE file{
+        CreateFileW(path.c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, nullptr)
+    };
+    if(file == INVALID_HANDLE_VALUE)
+        return;
+    m_FileHandle = file;
+
+    LARGE_INTEGER size{};
+    if(not GetFileSizeEx(file, &size) or size.QuadPart == 0)
+        return;
+
+    m_MappingHandle = CreateFileMappingW(file, nullptr, PAGE_READONLY, 0, 0, nullptr);
+    if(m_MappingHandle == nullptr)
+        return;
+
+    m_pData = static_cast<const std::byte*>(MapViewOfFile(m_MappingHandle, FILE_MAP_READ, 0, 0, 0));
+    if(m_pData != nullptr)
+        m_Size = static_cast<size_t>(size.QuadPart);
+}
+
+MappedFile::~MappedFile()
+{
+    if(m_pData != nullptr)
+        UnmapViewOfFile(m_pData);
+    if(m_MappingHandle != nullptr)
+        CloseHandle(m_MappingHandle);
+    if(m_FileHandle != nullptr)
+        CloseHandle(m_FileHandle);
+}
+#else
+MappedFile::MappedFile(const std::filesystem::path& path)
+{
+    const int file{ open(path.c_str(), O_RDONLY) };
+    if(file < 0)
+        return;
+
+    // The mapping keeps its own reference to the file, the descriptor can be closed right away
+    struct stat status{};
+    if(fstat(file, &status) == 0 and status.st_size > 0)
+    {
+        void* const pData{ mmap(nullptr, static_cast<size_t>(status.st_size), PROT_READ, MAP_PRIVATE, file, 0) };
+        if(pData != MAP_FAILED)
+        {
+            m_pData = static_cast<const std::byte*>(pData);
+            m_Size = static_cast<size_t>(status.st_size);
+        }
+    }
+    close(file);
+}
+
+MappedFile::~MappedFile()
+{
+    if(m_pData != nullptr)
+        munmap(const_cast<std::byte*>(m_pData), m_Size);
+}
+#endif
+}  // namespace dae
@@ -2,14 +2,20 @@
 #include "Renderer.hpp"
 
 #include <algorithm>
+#include <bit>
+#include <chrono>
+#include <cmath>
 #include <cstdint>
 #include <execution>
 #include <numeric>
 
 #include "ColorRGB.hpp"
 #include "DataTypes.hpp"
+#include "FrameArena.hpp"
 #include "Material.hpp"
+#include "MathHelpers.hpp"
 #include "Matrix.hpp"
+#include "ParallelUtils.hpp"
 #include "Scene.hpp"
 #include "SDL_events.h"
 #include "SDL_surface.h"
@@ -18,62 +24,668 @@
 
 using namespace dae;
 
+namespace
+{
+constexpr size_t SORT_CHUNK_SIZE{ 16384 };
+constexpr uint32_t RAY_SORT_KEY_BITS{ 30 };
+constexpr uint32_t RADIX_BITS{ 8 };
+constexpr uint32_t RADIX_SIZE{ 1u << RADIX_BITS };
+}  // namespace
+
 Renderer::Renderer(SDL_Window* pWindow)
     : m_pWindow(pWindow)
     , m_pBuffer(SDL_GetWindowSurface(pWindow))
-    , m_pBufferPixels(static_cast<uint32_t*>(m_pBuffer->pixels))
+    , m_FrameBuffer(m_pBuffer->w, m_pBuffer->h)
+    , m_Accumulation(m_pBuffer->w * m_pBuffer->h)
+    , m_ReprojectionCache(m_pBuffer->w, m_pBuffer->h)
 {
     // Initialize
     SDL_GetWindowSize(pWindow, &m_Width, &m_Height);
     const uint32_t pixelCount{ static_cast<uint32_t>(m_Width * m_Height) };
     m_PixelIndices.resize(pixelCount);
     std::iota(m_PixelIndices.begin(), m_PixelIndices.end(), 0);
+
+    const int tileCount{ ((m_Width + TILE_SIZE - 1) / TILE_SIZE) * ((m_Height + TILE_SIZE - 1) / TILE_SIZE) };
+    m_TileIndices.resize(static_cast<size_t>(tileCount));
+    std::iota(m_TileIndices.begin(), m_TileIndices.end(), 0);
 }
 
-void Renderer::Render(Scene* pScene) const
+void Renderer::Render(Scene* pScene)
 {
+    // Last frame's scratch memory is free again on every thread
+    FrameArena::BeginFrame();
+
     Camera& camera = pScene->GetCamera();
     static const float aspectRatio{ static_cast<float>(m_Width) / static_cast<float>(m_Height) };
-    const float fov{ camera.fov };
+    const FrameContext frame{ .cameraToWorld = camera.CalculateCameraToWorld(),
+                              .cameraOrigin = camera.origin,
+                              .fov = camera.fov,
+                              .aspectRatio = aspectRatio,
+                              // Lighting mode and shadow state are fixed for the frame, pick the matching kernel once
+                              .shadeHit = SelectLightingKernel() };
 
+    if(m_ReprojectionEnabled)
+    {
+        if(pScene->IsAnyDirty())
+            m_ReprojectionCache.Invalidate();
 
-    std::for_each(
-        std::execution::par, m_PixelIndices.begin(), m_PixelIndices.end(),
-        [&](const uint32_t pixelIdx)
-        {
-            const auto px{ pixelIdx % m_Width };
-            const auto py{ pixelIdx / m_Width };
+        m_ReprojectionCache.Reproject(Matrix::Inverse(frame.cameraToWorld), frame.fov, frame.aspectRatio);
+    }
+
+    pScene->UpdateSphereAcceleration();
+    pScene->UpdateOccluderOrder();
+    pScene->UpdateLightStructures();
+
+    switch(m_Integrator)
+    {
+        case Integrator::TiledBatchedShadows:
+            std::for_each(std::execution::par, m_TileIndices.begin(), m_TileIndices.end(),
+                          [&](const int tileIdx) { RenderTile(pScene, frame, tileIdx); });
+            break;
+        case Integrator::Wavefront:
+            RenderWavefront(pScene, frame);
+            break;
+        case Integrator::PathTracer:
+            RenderPathTraced(pScene, frame);
+            break;
+        default:
+            std::for_each(std::execution::par, m_PixelIndices.begin(), m_PixelIndices.end(),
+                          [&](const int pixelIdx) { RenderPixel(pScene, frame, pixelIdx); });
+            break;
+    }
+
+    pScene->ClearDirtyFlags();
+
+    // Tone map and pack into the SDL Surface
+    m_FrameBuffer.Resolve(m_pBuffer);
+
+    //@END
+    // Update SDL Surface
+    SDL_UpdateWindowSurface(m_pWindow);
+}
+
+Ray Renderer::GenerateViewRay(const FrameContext& frame, int px, int py, float& localDirectionZ, float jitterX,
+                              float jitterY) const
+{
+    // Get camera position
+    const Vector3 ndc{ ((2.F * (static_cast<float>(px) + jitterX) / static_cast<float>(m_Width)) - 1) * frame.aspectRatio * frame.fov,
+                       (1 - ((2.F * (static_cast<float>(py) + jitterY) / static_cast<float>(m_Width)) * frame.aspectRatio)) * frame.fov,
+                       1 };
+
+    const Vector3 localRayDirection{ (ndc).Normalized() };
+    localDirectionZ = localRayDirection.z;
+
+    return { .origin = frame.cameraOrigin, .direction = frame.cameraToWorld.TransformVector(localRayDirection) };
+}
 
-            // Get camera position
-            const Vector3 ndc{ ((2.F * (static_cast<float>(px) + 0.5F) / static_cast<float>(m_Width)) - 1) * aspectRatio * fov,
-                               (1 - ((2.F * (static_cast<float>(py) + 0.5F) / static_cast<float>(m_Width)) * aspectRatio)) * fov,
-                               1 };
+void Renderer::RenderPixel(const Scene* pScene, const FrameContext& frame, int pixelIdx)
+{
+    float localDirectionZ{};
+    const Ray viewRay{ GenerateViewRay(frame, pixelIdx % m_Width, pixelIdx / m_Width, localDirectionZ) };
 
-            const Matrix cameraToWorld{ camera.CalculateCameraToWorld() };
+    HitRecord closestHit{};
+    pScene->GetClosestHit(viewRay, closestHit);
 
-            const Vector3 localRayDirection{ (ndc).Normalized() };
-            const Vector3 worldRayDirection = cameraToWorld.TransformVector(localRayDirection);
+    if(closestHit.didHit and m_ReprojectionEnabled and m_ReprojectionCache.IsReusable(pixelIdx, closestHit.t * localDirectionZ))
+    {
+        m_FrameBuffer.SetPixel(pixelIdx, m_ReprojectionCache.GetSample(pixelIdx).color);
+        return;
+    }
 
-            const Ray viewRay{ .origin = camera.origin, .direction = worldRayDirection };
+    ColorRGB finalColor{};
+    if(closestHit.didHit)
+    {
+        finalColor = (this->*frame.shadeHit)(pScene, closestHit, nullptr);
+    }
+
+    if(m_ReprojectionEnabled)
+        m_ReprojectionCache.Store(pixelIdx, closestHit, finalColor, closestHit.t * localDirectionZ);
+
+    m_FrameBuffer.SetPixel(pixelIdx, finalColor);
+}
+
+void Renderer::RenderTile(const Scene* pScene, const FrameContext& frame, int tileIdx)
+{
+    const int tilesPerRow{ (m_Width + TILE_SIZE - 1) / TILE_SIZE };
+    const int firstX{ (tileIdx % tilesPerRow) * TILE_SIZE };
+    const int firstY{ (tileIdx / tilesPerRow) * TILE_SIZE };
+    const int endX{ std::min(firstX + TILE_SIZE, m_Width) };
+    const int endY{ std::min(firstY + TILE_SIZE, m_Height) };
+    const size_t tilePixelCount{ static_cast<size_t>((endX - firstX) * (endY - firstY)) };
+
+    // Scratch only lives for this tile, the next tile this thread renders reuses the same arena memory
+    FrameArena& arena{ FrameArena::GetThreadArena() };
+    const FrameArena::Scope arenaScope{ arena };
+    const std::span<int> pixelIndices{ arena.AllocateArray<int>(tilePixelCount) };
+    const std::span<HitRecord> hits{ arena.AllocateArray<HitRecord>(tilePixelCount) };
+    const std::span<float> depths{ arena.AllocateArray<float>(tilePixelCount) };
+
+    // Primary hits
+    size_t hitCount{};
+    for(int py{ firstY }; py < endY; ++py)
+    {
+        for(int px{ firstX }; px < endX; ++px)
+        {
+            const int pixelIdx{ px + (py * m_Width) };
+            float localDirectionZ{};
+            const Ray viewRay{ GenerateViewRay(frame, px, py, localDirectionZ) };
 
             HitRecord closestHit{};
             pScene->GetClosestHit(viewRay, closestHit);
+            if(not closestHit.didHit)
+            {
+                if(m_ReprojectionEnabled)
+                    m_ReprojectionCache.Store(pixelIdx, closestHit, {}, 0.f);
+
+                m_FrameBuffer.SetPixel(pixelIdx, {});
+                continue;
+            }
 
-            ColorRGB finalColor{};
-            if(closestHit.didHit)
+            const float depth{ closestHit.t * localDirectionZ };
+            if(m_ReprojectionEnabled and m_ReprojectionCache.IsReusable(pixelIdx, depth))
             {
-                finalColor = CalculateLighting(pScene, closestHit);
+                m_FrameBuffer.SetPixel(pixelIdx, m_ReprojectionCache.GetSample(pixelIdx).color);
+                continue;
             }
-            finalColor.MaxToOne();
 
-            m_pBufferPixels[px + (py * m_Width)] =
-                SDL_MapRGB(m_pBuffer->format, static_cast<uint8_t>(finalColor.r * 255), static_cast<uint8_t>(finalColor.g * 255),
-                           static_cast<uint8_t>(finalColor.b * 255));
-        });
+            pixelIndices[hitCount] = pixelIdx;
+            hits[hitCount] = closestHit;
+            depths[hitCount] = depth;
+            ++hitCount;
+        }
+    }
+
+    // Shadow rays, one coherent batch per light
+    const std::vector<Light>& lights{ pScene->GetLights() };
+    const LightGrid& lightGrid{ pScene->GetLightGrid() };
+    const std::span<uint8_t> lightVisibility{ arena.AllocateArray<uint8_t>(hitCount * lights.size()) };  // [hit][light]
+    std::ranges::fill(lightVisibility, uint8_t{ 1 });
+    if(m_ShadowsEnabled)
+    {
+        const std::span<ShadowRay> shadowRays{ arena.AllocateArray<ShadowRay>(hitCount) };
+        for(size_t lightIdx{}; lightIdx < lights.size(); ++lightIdx)
+        {
+            const Light& light{ lights[lightIdx] };
 
-    //@END
-    // Update SDL Surface
-    SDL_UpdateWindowSurface(m_pWindow);
+            size_t shadowRayCount{};
+            for(uint32_t hitIdx{}; hitIdx < hitCount; ++hitIdx)
+            {
+                const HitRecord& hit{ hits[hitIdx] };
+
+                // Same early outs as the shading, area lights trace their own samples while shading
+                if(LightUtils::IsAreaLight(light) or Vector3::Dot(hit.normal, light.origin - hit.origin) <= 0 or
+                   not lightGrid.IsInRange(lightIdx, hit.origin))
+                    continue;
+
+                Ray shadowRay{};
+                if(not GetShadowRay(light, hit, shadowRay))
+                {
+                    lightVisibility[(hitIdx * lights.size()) + lightIdx] = 0;
+                    continue;
+                }
+                shadowRays[shadowRayCount++] = { .ray = shadowRay,
+                                                 .hitIdx = hitIdx,
+                                                 .sortKey = GetDirectionSortKey(shadowRay.direction) };
+            }
+
+            const std::span<ShadowRay> lightShadowRays{ shadowRays.first(shadowRayCount) };
+            std::ranges::sort(lightShadowRays, std::ranges::less{}, &ShadowRay::sortKey);
+
+            OccluderReference occluder{};
+            for(const ShadowRay& shadowRay : lightShadowRays)
+            {
+                lightVisibility[(shadowRay.hitIdx * lights.size()) + lightIdx] =
+                    pScene->IsOccluded(shadowRay.ray, occluder) ? 0 : 1;
+            }
+        }
+    }
+
+    // Shading
+    for(size_t hitIdx{}; hitIdx < hitCount; ++hitIdx)
+    {
+        const int pixelIdx{ pixelIndices[hitIdx] };
+        const ColorRGB finalColor{ (this->*frame.shadeHit)(pScene, hits[hitIdx],
+                                                           lightVisibility.data() + (hitIdx * lights.size())) };
+
+        if(m_ReprojectionEnabled)
+            m_ReprojectionCache.Store(pixelIdx, hits[hitIdx], finalColor, depths[hitIdx]);
+
+        m_FrameBuffer.SetPixel(pixelIdx, finalColor);
+    }
+}
+
+void Renderer::RenderWavefront(const Scene* pScene, const FrameContext& frame)
+{
+    WavefrontQueues& queues{ m_Wavefront };
+
+    // Ray generation, one primary slot per pixel
+    const size_t rayCount{ m_PixelIndices.size() };
+    queues.primaryRays.Resize(rayCount);
+    queues.depthScales.resize(rayCount);
+    queues.hits.resize(rayCount);
+    queues.needsShading.resize(rayCount);
+    queues.primarySlots.resize(rayCount);
+    std::iota(queues.primarySlots.begin(), queues.primarySlots.end(), 0u);
+
+    std::for_each(std::execution::par, queues.primarySlots.begin(), queues.primarySlots.end(),
+                  [&](const uint32_t slot)
+                  {
+                      const int pixelIdx{ static_cast<int>(slot) };
+                      queues.primaryRays.Set(slot, GenerateViewRay(frame, pixelIdx % m_Width, pixelIdx / m_Width,
+                                                                   queues.depthScales[slot]));
+                  });
+
+    // Intersection, hits that still see their reprojected surface reuse its shading
+    std::for_each(std::execution::par, queues.primarySlots.begin(), queues.primarySlots.end(),
+                  [&](const uint32_t slot)
+                  {
+                      HitRecord& hit{ queues.hits[slot] };
+                      hit = {};
+                      pScene->GetClosestHit(queues.primaryRays.Get(slot), hit);
+
+                      const float depth{ hit.t * queues.depthScales[slot] };
+                      const bool isReused{ m_ReprojectionEnabled and
+                                           m_ReprojectionCache.IsReusable(static_cast<int>(slot), depth) };
+                      queues.needsShading[slot] = hit.didHit and not isReused;
+                  });
+
+    // Misses and reused hits are final, compact the rest for the remaining stages
+    queues.hitSlots.resize(rayCount);
+    const auto hitEnd{ std::copy_if(std::execution::par, queues.primarySlots.begin(), queues.primarySlots.end(),
+                                    queues.hitSlots.begin(),
+                                    [&](const uint32_t slot) { return queues.needsShading[slot] != 0; }) };
+    queues.hitSlots.erase(hitEnd, queues.hitSlots.end());
+
+    std::for_each(std::execution::par, queues.primarySlots.begin(), queues.primarySlots.end(),
+                  [&](const uint32_t slot)
+                  {
+                      if(queues.needsShading[slot])
+                          return;
+
+                      const int pixelIdx{ static_cast<int>(slot) };
+                      if(queues.hits[slot].didHit)
+                      {
+                          m_FrameBuffer.SetPixel(pixelIdx, m_ReprojectionCache.GetSample(pixelIdx).color);
+                          return;
+                      }
+
+                      if(m_ReprojectionEnabled)
+                          m_ReprojectionCache.Store(pixelIdx, queues.hits[slot], {}, 0.f);
+
+                      m_FrameBuffer.SetPixel(pixelIdx, {});
+                  });
+
+    // Shadow ray generation, one slot per primary slot and light
+    const std::vector<Light>& lights{ pScene->GetLights() };
+    const size_t lightCount{ lights.size() };
+    const LightGrid& lightGrid{ pScene->GetLightGrid() };
+    const size_t shadowRayCount{ rayCount * lightCount };
+    queues.lightVisibility.assign(shadowRayCount, 1);
+
+    if(m_ShadowsEnabled)
+    {
+        enum ShadowRayState : uint8_t
+        {
+            Skipped,  // Miss, reused hit, area light or light not facing the surface, shading never reads the visibility
+            Blocked,  // Light is behind the offset surface
+            Active
+        };
+
+        queues.shadowRays.Resize(shadowRayCount);
+        queues.shadowRayStates.resize(shadowRayCount);
+        queues.shadowRaySlots.resize(shadowRayCount);
+        std::iota(queues.shadowRaySlots.begin(), queues.shadowRaySlots.end(), 0u);
+
+        std::for_each(std::execution::par, queues.shadowRaySlots.begin(), queues.shadowRaySlots.end(),
+                      [&](const uint32_t shadowSlot)
+                      {
+                          const HitRecord& hit{ queues.hits[shadowSlot / lightCount] };
+                          const Light& light{ lights[shadowSlot % lightCount] };
+
+                          if(not queues.needsShading[shadowSlot / lightCount] or LightUtils::IsAreaLight(light) or
+                             Vector3::Dot(hit.normal, light.origin - hit.origin) <= 0 or
+                             not lightGrid.IsInRange(static_cast<uint32_t>(shadowSlot % lightCount), hit.origin))
+                          {
+                              queues.shadowRayStates[shadowSlot] = Skipped;
+                              return;
+                          }
+
+                          Ray shadowRay{};
+                          queues.shadowRayStates[shadowSlot] = GetShadowRay(light, hit, shadowRay) ? Active : Blocked;
+                          queues.shadowRays.Set(shadowSlot, shadowRay);
+                      });
+
+        queues.activeShadowSlots.resize(shadowRayCount);
+        const auto shadowEnd{ std::copy_if(std::execution::par, queues.shadowRaySlots.begin(), queues.shadowRaySlots.end(),
+                                           queues.activeShadowSlots.begin(),
+                                           [&](const uint32_t shadowSlot)
+                                           { return queues.shadowRayStates[shadowSlot] != Skipped; }) };
+        queues.activeShadowSlots.erase(shadowEnd, queues.activeShadowSlots.end());
+
+        // Shadow tests
+        std::for_each(std::execution::par, queues.activeShadowSlots.begin(), queues.activeShadowSlots.end(),
+                      [&](const uint32_t shadowSlot)
+                      {
+                          thread_local std::vector<OccluderReference> occluderCache;
+                          if(occluderCache.size() < lightCount)
+                              occluderCache.resize(lightCount);
+
+                          const bool isVisible{ queues.shadowRayStates[shadowSlot] == Active and
+                                                not pScene->IsOccluded(queues.shadowRays.Get(shadowSlot),
+                                                                       occluderCache[shadowSlot % lightCount]) };
+                          queues.lightVisibility[shadowSlot] = isVisible ? 1 : 0;
+                      });
+    }
+
+    // Shading
+    std::for_each(std::execution::par, queues.hitSlots.begin(), queues.hitSlots.end(),
+                  [&](const uint32_t slot)
+                  {
+                      const HitRecord& hit{ queues.hits[slot] };
+                      const ColorRGB finalColor{ (this->*frame.shadeHit)(pScene, hit,
+                                                                         queues.lightVisibility.data() + (slot * lightCount)) };
+
+                      const int pixelIdx{ static_cast<int>(slot) };
+                      if(m_ReprojectionEnabled)
+                          m_ReprojectionCache.Store(pixelIdx, hit, finalColor, hit.t * queues.depthScales[slot]);
+
+                      m_FrameBuffer.SetPixel(pixelIdx, finalColor);
+                  });
+}
+
+void Renderer::RenderPathTraced(const Scene* pScene, const FrameContext& frame)
+{
+    if(not(frame.cameraToWorld == m_AccumulationCamera) or pScene->IsAnyDirty())
+    {
+        m_Accumulation.Reset();
+        m_AccumulationCamera = frame.cameraToWorld;
+    }
+
+    const auto frameStart{ std::chrono::steady_clock::now() };
+    const std::chrono::duration<float, std::milli> timeBudget{ m_PathTracerSettings.frameTimeBudgetMs };
+
+    while(m_Accumulation.GetSampleCount() < m_PathTracerSettings.maxSamplesPerPixel)
+    {
+        TracePaths(pScene, frame, m_Accumulation.GetSampleCount());
+        m_Accumulation.EndPass();
+
+        if(std::chrono::steady_clock::now() - frameStart >= timeBudget)
+            break;
+    }
+
+    std::for_each(std::execution::par, m_PixelIndices.begin(), m_PixelIndices.end(),
+                  [&](const int pixelIdx) { m_FrameBuffer.SetPixel(pixelIdx, m_Accumulation.GetAverage(pixelIdx)); });
+}
+
+void Renderer::TracePaths(const Scene* pScene, const FrameContext& frame, uint32_t sampleIdx)
+{
+    // Whether reordering pays for itself depends on the scene and the caches, so passes traced path by path and passes
+    // with sorted bounces are timed against each other. The cheaper one is kept, the other is retried every
+    // RAY_SORT_PROBE_INTERVAL passes. Both trace exactly the same paths.
+    RaySortStatistics& statistics{ m_RaySortStatistics };
+    const bool canSort{ m_PixelIndices.size() >= RAY_SORT_THRESHOLD };
+    const bool isProbePass{ statistics.passCount < 2 or statistics.passCount % RAY_SORT_PROBE_INTERVAL == 0 };
+    const bool isSortCheaper{ statistics.passCount == 1 or statistics.nanosecondsPerPath[1] < statistics.nanosecondsPerPath[0] };
+    const bool sortRays{ canSort and (isProbePass ? not isSortCheaper : isSortCheaper) };
+
+    const auto passStart{ std::chrono::steady_clock::now() };
+    if(sortRays)
+    {
+        TracePathsSorted(pScene, frame, sampleIdx);
+    }
+    else
+    {
+        std::for_each(std::execution::par, m_PixelIndices.begin(), m_PixelIndices.end(),
+                      [&](const int pixelIdx) { m_Accumulation.AddSample(pixelIdx, TracePath(pScene, frame, pixelIdx, sampleIdx)); });
+    }
+
+    if(not canSort)
+        return;
+
+    const std::chrono::duration<float, std::nano> passTime{ std::chrono::steady_clock::now() - passStart };
+    const float passNanosecondsPerPath{ passTime.count() / static_cast<float>(m_PixelIndices.size()) };
+    float& nanosecondsPerPath{ statistics.nanosecondsPerPath[sortRays ? 1 : 0] };
+    nanosecondsPerPath = nanosecondsPerPath == 0.f ? passNanosecondsPerPath
+                                                   : std::lerp(nanosecondsPerPath, passNanosecondsPerPath, 0.25f);
+    ++statistics.passCount;
+}
+
+void Renderer::TracePathsSorted(const Scene* pScene, const FrameContext& frame, uint32_t sampleIdx)
+{
+    PathQueues& paths{ m_Paths };
+    const size_t pathCount{ m_PixelIndices.size() };
+    paths.states.resize(pathCount);
+    paths.isPathAlive.resize(pathCount);
+    paths.activePaths.resize(pathCount);
+    std::ranges::copy(m_PixelIndices, paths.activePaths.begin());
+
+    std::for_each(std::execution::par, m_PixelIndices.begin(), m_PixelIndices.end(),
+                  [&](const int pixelIdx) { paths.states[pixelIdx] = StartPath(frame, pixelIdx, sampleIdx); });
+
+    for(uint32_t bounce{}; bounce < m_PathTracerSettings.maxBounces and not paths.activePaths.empty(); ++bounce)
+    {
+        // Primary rays leave in pixel order and are coherent already, bounced ones are scattered over the scene
+        if(bounce > 0 and paths.activePaths.size() >= RAY_SORT_THRESHOLD)
+            SortPaths();
+
+        std::for_each(std::execution::par, paths.activePaths.begin(), paths.activePaths.end(),
+                      [&](const uint32_t pathIdx)
+                      { paths.isPathAlive[pathIdx] = ExtendPath(pScene, paths.states[pathIdx], bounce) ? 1 : 0; });
+
+        paths.nextActivePaths.resize(paths.activePaths.size());
+        const auto aliveEnd{ std::copy_if(std::execution::par, paths.activePaths.begin(), paths.activePaths.end(),
+                                          paths.nextActivePaths.begin(),
+                                          [&](const uint32_t pathIdx) { return paths.isPathAlive[pathIdx] != 0; }) };
+        paths.nextActivePaths.erase(aliveEnd, paths.nextActivePaths.end());
+        std::swap(paths.activePaths, paths.nextActivePaths);
+    }
+
+    std::for_each(std::execution::par, m_PixelIndices.begin(), m_PixelIndices.end(),
+                  [&](const int pixelIdx) { m_Accumulation.AddSample(pixelIdx, paths.states[pixelIdx].radiance); });
+}
+
+ColorRGB Renderer::TracePath(const Scene* pScene, const FrameContext& frame, int pixelIdx, uint32_t sampleIdx) const
+{
+    PathState path{ StartPath(frame, pixelIdx, sampleIdx) };
+    for(uint32_t bounce{}; bounce < m_PathTracerSettings.maxBounces; ++bounce)
+    {
+        if(not ExtendPath(pScene, path, bounce))
+            break;
+    }
+    return path.radiance;
+}
+
+Renderer::PathState Renderer::StartPath(const FrameContext& frame, int pixelIdx, uint32_t sampleIdx) const
+{
+    PathState path{ .ray = {},
+                    .throughput = colors::White,
+                    .radiance = {},
+                    .rngState = HashPCG(static_cast<uint32_t>(pixelIdx) ^ HashPCG(sampleIdx)) };
+
+    float localDirectionZ{};
+    path.ray = GenerateViewRay(frame, pixelIdx % m_Width, pixelIdx / m_Width, localDirectionZ, RandomFloat(path.rngState),
+                               RandomFloat(path.rngState));
+    return path;
+}
+
+bool Renderer::ExtendPath(const Scene* pScene, PathState& path, uint32_t bounce) const
+{
+    const Ray& ray{ path.ray };
+    uint32_t& rngState{ path.rngState };
+    ColorRGB& throughput{ path.throughput };
+    ColorRGB& radiance{ path.radiance };
+
+    const std::vector<Material*>& materials{ pScene->GetMaterials() };
+    const std::vector<Light>& lights{ pScene->GetLights() };
+
+    thread_local std::vector<OccluderReference> occluderCache;
+    if(occluderCache.size() < lights.size())
+        occluderCache.resize(lights.size());
+
+    HitRecord hit{};
+    pScene->GetClosestHit(ray, hit);
+    if(not hit.didHit)
+        return false;
+
+    // Planes and unculled triangles can be hit from behind, shade the side the ray arrived on
+    if(Vector3::Dot(hit.normal, ray.direction) > 0.f)
+        hit.normal = -hit.normal;
+
+    Material* pMaterial{ materials[hit.materialIndex] };
+    const Vector3 hitToCamera{ -ray.direction };
+
+    // Next event estimation, towards every light in range or a few picked from the light tree
+    const LightGrid& lightGrid{ pScene->GetLightGrid() };
+    const auto evaluate{ [&](const Vector3& hitToLight, const ColorRGB& lightRadiance, float observedArea) -> ColorRGB
+                         { return lightRadiance * pMaterial->Shade(hit, hitToLight, hitToCamera) * observedArea; } };
+
+    const auto estimateLight{ [&](size_t lightIdx) -> ColorRGB
+                              {
+                                  const Light& light{ lights[lightIdx] };
+                                  if(not lightGrid.IsInRange(static_cast<uint32_t>(lightIdx), hit.origin))
+                                      return {};
+
+                                  if(LightUtils::IsAreaLight(light))
+                                  {
+                                      return SampleAreaLight(pScene, light, hit, occluderCache[lightIdx], m_ShadowsEnabled,
+                                                             evaluate);
+                                  }
+
+                                  const Vector3 hitToLight{ light.type == LightType::Directional
+                                                                ? -light.direction
+                                                                : (light.origin - hit.origin).Normalized() };
+                                  const float observedArea{ Vector3::Dot(hit.normal, hitToLight) };
+                                  if(observedArea <= 0.f)
+                                      return {};
+
+                                  if(m_ShadowsEnabled and IsOccluded(pScene, light, hit, occluderCache[lightIdx]))
+                                      return {};
+
+                                  return evaluate(hitToLight, LightUtils::GetRadiance(light, hit.origin), observedArea);
+                              } };
+
+    const LightTree& lightTree{ pScene->GetLightTree() };
+    if(m_LightSamplingEnabled and lightTree.HasPointLights())
+    {
+        for(const uint32_t lightIdx : lightTree.GetDirectionalLights())
+            radiance += throughput * estimateLight(lightIdx);
+
+        for(uint32_t sampleIdx{}; sampleIdx < m_LightSamplesPerHit; ++sampleIdx)
+        {
+            LightTree::LightSample lightSample{};
+            if(lightTree.Sample(hit.origin, hit.normal, RandomFloat(rngState), lightSample))
+            {
+                radiance += throughput * estimateLight(lightSample.lightIndex) /
+                    (static_cast<float>(m_LightSamplesPerHit) * lightSample.pdf);
+            }
+        }
+    }
+    else
+    {
+        for(const uint32_t lightIdx : lightGrid.GetUnboundedLights())
+            radiance += throughput * estimateLight(lightIdx);
+        for(const uint32_t lightIdx : lightGrid.GetLights(hit.origin))
+            radiance += throughput * estimateLight(lightIdx);
+    }
+
+    const MaterialSample sample{ pMaterial->Sample(hit, hitToCamera, RandomFloat(rngState), RandomFloat(rngState)) };
+    if(not sample.isValid)
+        return false;
+
+    throughput *= sample.weight;
+
+    // bounce counts the bounce rays spawned before this one, so the first russianRouletteDepth of them always survive
+    if(bounce >= m_PathTracerSettings.russianRouletteDepth)
+    {
+        const float survivalProbability{ std::min(std::max({ throughput.r, throughput.g, throughput.b }), 0.95f) };
+        if(RandomFloat(rngState) >= survivalProbability)
+            return false;
+
+        throughput /= survivalProbability;
+    }
+
+    path.ray = { .origin = hit.origin + (hit.normal * 0.001f), .direction = sample.direction };
+    return true;
+}
+
+void Renderer::SortPaths()
+{
+    PathQueues& paths{ m_Paths };
+    const size_t activeCount{ paths.activePaths.size() };
+
+    Vector3 boundsMin{ FLT_MAX, FLT_MAX, FLT_MAX };
+    Vector3 boundsMax{ -FLT_MAX, -FLT_MAX, -FLT_MAX };
+    for(const uint32_t pathIdx : paths.activePaths)
+    {
+        boundsMin = Vector3::Min(boundsMin, paths.states[pathIdx].ray.origin);
+        boundsMax = Vector3::Max(boundsMax, paths.states[pathIdx].ray.origin);
+    }
+
+    // Octant above a 27-bit Morton code, 9 bits per axis
+    const Vector3 extent{ boundsMax - boundsMin };
+    const Vector3 gridScale{ extent.x > 0.f ? 511.f / extent.x : 0.f, extent.y > 0.f ? 511.f / extent.y : 0.f,
+                             extent.z > 0.f ? 511.f / extent.z : 0.f };
+
+    paths.sortKeys.resize(activeCount);
+    ForEachChunk(paths.chunkIndices, activeCount, SORT_CHUNK_SIZE,
+                 [&](size_t begin, size_t end)
+                 {
+                     for(size_t idx{ begin }; idx < end; ++idx)
+                     {
+                         const Ray& ray{ paths.states[paths.activePaths[idx]].ray };
+                         const uint32_t octant{ (ray.direction.x < 0.f ? 4u : 0u) | (ray.direction.y < 0.f ? 2u : 0u) |
+                                                (ray.direction.z < 0.f ? 1u : 0u) };
+                         const auto x{ static_cast<uint32_t>((ray.origin.x - boundsMin.x) * gridScale.x) };
+                         const auto y{ static_cast<uint32_t>((ray.origin.y - boundsMin.y) * gridScale.y) };
+                         const auto z{ static_cast<uint32_t>((ray.origin.z - boundsMin.z) * gridScale.z) };
+                         paths.sortKeys[idx] = (octant << 27) | (SpreadBits(x) << 2) | (SpreadBits(y) << 1) | SpreadBits(z);
+                     }
+                 });
+
+    // LSD radix sort of the paths by key, 8 bits a pass. Every chunk counts its digits, an exclusive scan over (digit, chunk)
+    // turns the counts into write offsets and the chunks scatter in parallel.
+    const size_t chunkCount{ (activeCount + SORT_CHUNK_SIZE - 1) / SORT_CHUNK_SIZE };
+    paths.nextSortKeys.resize(activeCount);
+    paths.nextActivePaths.resize(activeCount);
+    paths.radixHistograms.resize(chunkCount * RADIX_SIZE);
+    for(uint32_t shift{}; shift < RAY_SORT_KEY_BITS; shift += RADIX_BITS)
+    {
+        std::ranges::fill(paths.radixHistograms, 0u);
+        ForEachChunk(paths.chunkIndices, activeCount, SORT_CHUNK_SIZE,
+                     [&](size_t begin, size_t end)
+                     {
+                         uint32_t* const pHistogram{ &paths.radixHistograms[(begin / SORT_CHUNK_SIZE) * RADIX_SIZE] };
+                         for(size_t idx{ begin }; idx < end; ++idx)
+                             ++pHistogram[(paths.sortKeys[idx] >> shift) & (RADIX_SIZE - 1)];
+                     });
+
+        uint32_t offset{};
+        for(uint32_t digit{}; digit < RADIX_SIZE; ++digit)
+        {
+            for(size_t chunkIdx{}; chunkIdx < chunkCount; ++chunkIdx)
+            {
+                uint32_t& count{ paths.radixHistograms[(chunkIdx * RADIX_SIZE) + digit] };
+                const uint32_t digitCount{ count };
+                count = offset;
+                offset += digitCount;
+            }
+        }
+
+        ForEachChunk(paths.chunkIndices, activeCount, SORT_CHUNK_SIZE,
+                     [&](size_t begin, size_t end)
+                     {
+                         uint32_t* const pOffsets{ &paths.radixHistograms[(begin / SORT_CHUNK_SIZE) * RADIX_SIZE] };
+                         for(size_t idx{ begin }; idx < end; ++idx)
+                         {
+                             const uint32_t slot{ pOffsets[(paths.sortKeys[idx] >> shift) & (RADIX_SIZE - 1)]++ };
+                             paths.nextSortKeys[slot] = paths.sortKeys[idx];
+                             paths.nextActivePaths[slot] = paths.activePaths[idx];
+                         }
+                     });
+
+        std::swap(paths.sortKeys, paths.nextSortKeys);
+        std::swap(paths.activePaths, paths.nextActivePaths);
+    }
 }
 
 bool Renderer::SaveBufferToImage() const
@@ -86,51 +698,208 @@ bool Renderer::IsInShadow(const Scene* pScene, const Light& light, const HitReco
     if(not m_ShadowsEnabled)
         return false;
 
+    OccluderReference occluder{};
+    return IsOccluded(pScene, light, closestHit, occluder);
+}
+
+bool Renderer::IsOccluded(const Scene* pScene, const Light& light, const HitRecord& closestHit,
+                          OccluderReference& cachedOccluder)
+{
+    Ray hitToLightRay{};
+    return not GetShadowRay(light, closestHit, hitToLightRay) or pScene->IsOccluded(hitToLightRay, cachedOccluder);
+}
+
+bool Renderer::GetShadowRay(const Light& light, const HitRecord& closestHit, Ray& shadowRay)
+{
     Vector3 hitToLight{ LightUtils::GetDirectionToLight(light, closestHit.origin + (closestHit.normal * 0.01f)) };
     const float hitToLightDistance{ hitToLight.Normalize() };
-    const Ray hitToLightRay{ .origin = closestHit.origin, .direction = hitToLight, .max = hitToLightDistance };
-
-    const float lightDot{ Vector3::Dot(closestHit.normal, hitToLight) };
+    shadowRay = { .origin = closestHit.origin, .direction = hitToLight, .max = hitToLightDistance };
 
-    return lightDot < 0 or pScene->DoesHit(hitToLightRay);
+    return Vector3::Dot(closestHit.normal, hitToLight) >= 0;
 }
 
-ColorRGB Renderer::CalculateLighting(const Scene* pScene, const HitRecord& closestHit) const
+template<typename EvaluateSample>
+ColorRGB Renderer::SampleAreaLight(const Scene* pScene, const Light& light, const HitRecord& closestHit,
+                                   OccluderReference& cachedOccluder, bool testShadows, const EvaluateSample& evaluate) const
 {
-    const auto& materials = pScene->GetMaterials();
-    const auto& lights = pScene->GetLights();
+    // Per hit and light scrambling turns the shared Sobol points into decorrelated strata across pixels
+    const uint32_t seed{ HashPCG(std::bit_cast<uint32_t>(closestHit.origin.x) ^
+                                 HashPCG(std::bit_cast<uint32_t>(closestHit.origin.y) ^
+                                         HashPCG(std::bit_cast<uint32_t>(closestHit.origin.z) ^
+                                                 std::bit_cast<uint32_t>(light.origin.x)))) };
+    const uint32_t scrambleU{ HashPCG(seed) };
+    const uint32_t scrambleV{ HashPCG(scrambleU) };
+
+    const uint32_t probeSamples{ std::min(AREA_LIGHT_PROBE_SAMPLES, m_AreaLightSamples) };
 
     ColorRGB lighting{};
-    for(const auto& light : lights)
+    uint32_t sampleCount{};
+    uint32_t litCount{};
+    while(sampleCount < m_AreaLightSamples)
     {
-        const Vector3 hitToLight{ (light.origin - closestHit.origin).Normalized() };
-        const float observedArea{ Vector3::Dot(closestHit.normal, hitToLight) };
+        if(sampleCount == probeSamples and (litCount == 0 or litCount == probeSamples))
+            break;
+
+        const LightUtils::AreaLightSample sample{ LightUtils::SampleAreaLight(
+            light, closestHit.origin, Sobol0(sampleCount, scrambleU), Sobol1(sampleCount, scrambleV)) };
+        ++sampleCount;
 
-        if(IsInShadow(pScene, light, closestHit) or observedArea <= 0)
+        Vector3 hitToLight{ sample.point - closestHit.origin };
+        const float distance{ hitToLight.Normalize() };
+        const float observedArea{ Vector3::Dot(closestHit.normal, hitToLight) };
+        if(observedArea <= 0.f)
             continue;
 
-        const Vector3 hitToCamera{ (pScene->GetCameraOrigin() - closestHit.origin).Normalized() };
-        const ColorRGB Ergb{ LightUtils::GetRadiance(light, closestHit.origin) };
-        const ColorRGB BRDFrgb{ pScene->GetMaterials()[closestHit.materialIndex]->Shade(closestHit, hitToLight, hitToCamera) };
+        if(testShadows)
+        {
+            const Ray shadowRay{ .origin = closestHit.origin, .direction = hitToLight, .max = distance };
+            if(pScene->IsOccluded(shadowRay, cachedOccluder))
+                continue;
+        }
+
+        ++litCount;
+        lighting += evaluate(hitToLight, sample.radiance, observedArea);
+    }
+    return lighting / static_cast<float>(sampleCount);
+}
 
-        switch(m_CurrentLightingMode)
+uint32_t Renderer::GetDirectionSortKey(const Vector3& direction)
+{
+    // Octant in the top bits, then the direction quantized to 8 bits per axis
+    const uint32_t octant{ (direction.x < 0 ? 4u : 0u) | (direction.y < 0 ? 2u : 0u) | (direction.z < 0 ? 1u : 0u) };
+    const auto quantize{ [](float value) { return static_cast<uint32_t>((std::clamp(value, -1.f, 1.f) * 127.5f) + 127.5f); } };
+    return (octant << 24) | (quantize(direction.x) << 16) | (quantize(direction.y) << 8) | quantize(direction.z);
+}
+
+ColorRGB Renderer::CalculateLighting(const Scene* pScene, const HitRecord& closestHit) const
+{
+    return (this->*SelectLightingKernel())(pScene, closestHit, nullptr);
+}
+
+Renderer::LightingKernel Renderer::SelectLightingKernel() const
+{
+    // [LightingMode][ShadowsEnabled]
+    static constexpr LightingKernel kernels[static_cast<size_t>(LightingMode::Count)][2]{
+        { &Renderer::ShadeHit<LightingMode::ObservedArea, false>, &Renderer::ShadeHit<LightingMode::ObservedArea, true> },
+        { &Renderer::ShadeHit<LightingMode::Radiance, false>, &Renderer::ShadeHit<LightingMode::Radiance, true> },
+        { &Renderer::ShadeHit<LightingMode::BRDF, false>, &Renderer::ShadeHit<LightingMode::BRDF, true> },
+        { &Renderer::ShadeHit<LightingMode::Combined, false>, &Renderer::ShadeHit<LightingMode::Combined, true> }
+    };
+
+    return kernels[static_cast<size_t>(m_CurrentLightingMode)][m_ShadowsEnabled ? 1 : 0];
+}
+
+template<Renderer::LightingMode lightingMode, bool shadowsEnabled>
+ColorRGB Renderer::ShadeHit(const Scene* pScene, const HitRecord& closestHit, const uint8_t* pLightVisibility) const
+{
+    constexpr bool needsBRDF{ lightingMode == LightingMode::BRDF or lightingMode == LightingMode::Combined };
+
+    Material* pMaterial{};
+    Vector3 hitToCamera{};
+    if constexpr(needsBRDF)
+    {
+        pMaterial = pScene->GetMaterials()[closestHit.materialIndex];
+        hitToCamera = (pScene->GetCameraOrigin() - closestHit.origin).Normalized();
+    }
+
+    const std::vector<Light>& lights{ pScene->GetLights() };
+
+    // Neighbouring pixels a thread shades tend to be blocked by the same geometry, remember the last occluder per light
+    thread_local std::vector<OccluderReference> occluderCache;
+    if constexpr(shadowsEnabled)
+    {
+        if(occluderCache.size() < lights.size())
+            occluderCache.resize(lights.size());
+    }
+
+    constexpr bool needsRadiance{ lightingMode != LightingMode::BRDF };
+    const auto evaluate{ [&](const Vector3& hitToLight, const ColorRGB& radiance, float observedArea) -> ColorRGB
+                         {
+                             if constexpr(lightingMode == LightingMode::ObservedArea)
+                             {
+                                 return radiance * observedArea;
+                             }
+                             else if constexpr(lightingMode == LightingMode::Radiance)
+                             {
+                                 return radiance;
+                             }
+                             else if constexpr(lightingMode == LightingMode::BRDF)
+                             {
+                                 return pMaterial->Shade(closestHit, hitToLight, hitToCamera);
+                             }
+                             else
+                             {
+                                 return radiance * pMaterial->Shade(closestHit, hitToLight, hitToCamera) * observedArea;
+                             }
+                         } };
+
+    // Every integrator drops the same lights beyond their influence radius, whether or not it traced their shadow rays
+    const LightGrid& lightGrid{ pScene->GetLightGrid() };
+    const auto shadeLight{ [&](size_t lightIdx) -> ColorRGB
+                           {
+                               const Light& light{ lights[lightIdx] };
+                               if(not lightGrid.IsInRange(static_cast<uint32_t>(lightIdx), closestHit.origin))
+                                   return {};
+
+                               // Soft shadows need a ray per sample, area lights are never part of the precomputed visibility
+                               if(LightUtils::IsAreaLight(light))
+                               {
+                                   OccluderReference unusedOccluder{};
+                                   OccluderReference& cachedOccluder{ shadowsEnabled ? occluderCache[lightIdx] : unusedOccluder };
+                                   return SampleAreaLight(pScene, light, closestHit, cachedOccluder, shadowsEnabled, evaluate);
+                               }
+
+                               const Vector3 hitToLight{ (light.origin - closestHit.origin).Normalized() };
+                               const float observedArea{ Vector3::Dot(closestHit.normal, hitToLight) };
+
+                               if(observedArea <= 0)
+                                   return {};
+
+                               if constexpr(shadowsEnabled)
+                               {
+                                   if(pLightVisibility != nullptr)
+                                   {
+                                       if(pLightVisibility[lightIdx] == 0)
+                                           return {};
+                                   }
+                                   else if(IsOccluded(pScene, light, closestHit, occluderCache[lightIdx]))
+                                       return {};
+                               }
+
+                               return evaluate(hitToLight,
+                                               needsRadiance ? LightUtils::GetRadiance(light, closestHit.origin) : ColorRGB{},
+                                               observedArea);
+                           } };
+
+    ColorRGB lighting{};
+
+    // Precomputed visibility covers every light, so only the tracing paths can sample
+    const LightTree& lightTree{ pScene->GetLightTree() };
+    if(m_LightSamplingEnabled and pLightVisibility == nullptr and lightTree.HasPointLights())
+    {
+        for(const uint32_t lightIdx : lightTree.GetDirectionalLights())
+            lighting += shadeLight(lightIdx);
+
+        // Seeded from the hit so the same surface point picks the same lights every frame
+        uint32_t rngState{ HashPCG(std::bit_cast<uint32_t>(closestHit.origin.x) ^
+                                   HashPCG(std::bit_cast<uint32_t>(closestHit.origin.y) ^
+                                           HashPCG(std::bit_cast<uint32_t>(closestHit.origin.z)))) };
+
+        for(uint32_t sampleIdx{}; sampleIdx < m_LightSamplesPerHit; ++sampleIdx)
         {
-            case LightingMode::ObservedArea:
-                lighting += Ergb * observedArea;
-                break;
-            case LightingMode::Radiance:
-                lighting += Ergb;
-                break;
-            case LightingMode::BRDF:
-                lighting += BRDFrgb;
-                break;
-            case LightingMode::Combined:
-                lighting += Ergb * BRDFrgb * observedArea;
-                break;
-            default:
-                break;
+            LightTree::LightSample sample{};
+            if(lightTree.Sample(closestHit.origin, closestHit.normal, RandomFloat(rngState), sample))
+                lighting += shadeLight(sample.lightIndex) / (static_cast<float>(m_LightSamplesPerHit) * sample.pdf);
         }
+        return lighting;
     }
+
+    // Only the lights whose influence reaches the hit
+    for(const uint32_t lightIdx : lightGrid.GetUnboundedLights())
+        lighting += shadeLight(lightIdx);
+    for(const uint32_t lightIdx : lightGrid.GetLights(closestHit.origin))
+        lighting += shadeLight(lightIdx);
+
     return lighting;
 }
 
@@ -146,6 +915,24 @@ void Renderer::ProcessInput(const SDL_Event& e)
             case SDL_SCANCODE_F3:
                 CycleLightingMode();
                 break;
+            case SDL_SCANCODE_F4:
+                ToggleReprojection();
+                break;
+            case SDL_SCANCODE_F5:
+                CycleToneMappingOperator();
+                break;
+            case SDL_SCANCODE_F6:
+                ToggleSRGB();
+                break;
+            case SDL_SCANCODE_F7:
+                ToggleDithering();
+                break;
+            case SDL_SCANCODE_F8:
+                CycleIntegrator();
+                break;
+            case SDL_SCANCODE_F9:
+                ToggleLightSampling();
+                break;
             default:
                 break;
         }
@@ -155,10 +942,79 @@ void Renderer::ProcessInput(const SDL_Event& e)
 void Renderer::ToggleShadows()
 {
     m_ShadowsEnabled = not m_ShadowsEnabled;
+    m_ReprojectionCache.Invalidate();
+    m_Accumulation.Reset();
+}
+
+void Renderer::CycleIntegrator()
+{
+    const auto next{ static_cast<uint8_t>(m_Integrator) + 1 };
+    m_Integrator = static_cast<Integrator>(next % static_cast<uint8_t>(Integrator::Count));
+
+    // The path tracer writes averaged colors the cache must not serve to the other integrators
+    m_ReprojectionCache.Invalidate();
+    m_Accumulation.Reset();
+}
+
+void Renderer::ToggleLightSampling()
+{
+    m_LightSamplingEnabled = not m_LightSamplingEnabled;
+    m_ReprojectionCache.Invalidate();
+    m_Accumulation.Reset();
+}
+
+void Renderer::SetLightSamplesPerHit(uint32_t samples)
+{
+    m_LightSamplesPerHit = std::max(samples, 1u);
+    m_ReprojectionCache.Invalidate();
+    m_Accumulation.Reset();
+}
+
+void Renderer::SetAreaLightSamples(uint32_t samples)
+{
+    m_AreaLightSamples = std::max(samples, 1u);
+    m_ReprojectionCache.Invalidate();
+    m_Accumulation.Reset();
+}
+
+void Renderer::SetPathTracerSampleBudget(uint32_t samplesPerPixel)
+{
+    m_PathTracerSettings.maxSamplesPerPixel = std::max(samplesPerPixel, 1u);
+}
+
+void Renderer::SetPathTracerTimeBudget(float milliseconds)
+{
+    m_PathTracerSettings.frameTimeBudgetMs = milliseconds;
+}
+
+void Renderer::ToggleReprojection()
+{
+    m_ReprojectionEnabled = not m_ReprojectionEnabled;
+    m_ReprojectionCache.Invalidate();
+}
+
+void Renderer::CycleToneMappingOperator()
+{
+    const auto next{ static_cast<uint8_t>(m_FrameBuffer.GetToneMappingOperator()) + 1 };
+    m_FrameBuffer.SetToneMappingOperator(
+        static_cast<FrameBuffer::ToneMappingOperator>(next % static_cast<uint8_t>(FrameBuffer::ToneMappingOperator::Count)));
+}
+
+void Renderer::ToggleSRGB()
+{
+    const bool isSRGB{ m_FrameBuffer.GetTransferFunction() == FrameBuffer::TransferFunction::SRGB };
+    m_FrameBuffer.SetTransferFunction(isSRGB ? FrameBuffer::TransferFunction::Linear : FrameBuffer::TransferFunction::SRGB);
+}
+
+void Renderer::ToggleDithering()
+{
+    m_FrameBuffer.SetDitheringEnabled(not m_FrameBuffer.IsDitheringEnabled());
 }
 
 void Renderer::CycleLightingMode()
 {
+    m_ReprojectionCache.Invalidate();
+
     switch(m_CurrentLightingMode)
     {
         case LightingMode::ObservedArea:
@@ -0,0 +1,107 @@
+#include "ReprojectionCache.hpp"
+
+#include <algorithm>
+#include <bit>
+#include <cmath>
+#include <execution>
+#include <numeric>
+
+#include "Vector3.hpp"
+
+namespace dae
+{
+ReprojectionCache::ReprojectionCache(int width, int height)
+    : m_Width(width)
+    , m_Height(height)
+    , m_Samples(static_cast<size_t>(width * height))
+    , m_PreviousSamples(static_cast<size_t>(width * height))
+    , m_ReprojectionTargets(std::make_unique<std::atomic<uint64_t>[]>(static_cast<size_t>(width * height)))
+{
+    m_PixelIndices.resize(m_Samples.size());
+    std::iota(m_PixelIndices.begin(), m_PixelIndices.end(), 0);
+}
+
+void ReprojectionCache::Reproject(const Matrix& worldToCamera, float fov, float aspectRatio)
+{
+    ++m_FrameIndex;
+    std::swap(m_Samples, m_PreviousSamples);
+
+    std::for_each(std::execution::par, m_PixelIndices.begin(), m_PixelIndices.end(),
+                  [&](const int pixelIdx) { m_ReprojectionTargets[pixelIdx].store(EMPTY_TARGET, std::memory_order_relaxed); });
+
+    // Scatter: every previous hit lands in the pixel whose footprint contains its projection
+    std::for_each(std::execution::par, m_PixelIndices.begin(), m_PixelIndices.end(),
+                  [&](const int sourceIdx)
+                  {
+                      const Sample& previous{ m_PreviousSamples[sourceIdx] };
+                      if(not previous.isValid)
+                          return;
+
+                      const Vector3 cameraSpace{ worldToCamera.TransformPoint(previous.hit.origin) };
+                      if(cameraSpace.z <= 0.f)
+                          return;
+
+                      const float screenX{ ((cameraSpace.x / cameraSpace.z / (aspectRatio * fov)) + 1.f) * 0.5f *
+                                           static_cast<float>(m_Width) };
+                      const float screenY{ (1.f - (cameraSpace.y / cameraSpace.z / fov)) * 0.5f * static_cast<float>(m_Height) };
+                      if(screenX < 0.f or screenY < 0.f or screenX >= static_cast<float>(m_Width) or
+                         screenY >= static_cast<float>(m_Height))
+                          return;
+
+                      const int targetIdx{ static_cast<int>(screenX) + (static_cast<int>(screenY) * m_Width) };
+
+                      // Positive floats keep their ordering when compared as integers
+                      const uint64_t packed{ (static_cast<uint64_t>(std::bit_cast<uint32_t>(cameraSpace.z)) << 32) |
+                                             static_cast<uint32_t>(sourceIdx) };
+
+                      std::atomic<uint64_t>& target{ m_ReprojectionTargets[targetIdx] };
+                      uint64_t current{ target.load(std::memory_order_relaxed) };
+                      while(packed < current and not target.compare_exchange_weak(current, packed, std::memory_order_relaxed))
+                      {
+                      }
+                  });
+
+    // Gather: pixels nothing landed on are disoccluded and stay invalid
+    std::for_each(std::execution::par, m_PixelIndices.begin(), m_PixelIndices.end(),
+                  [&](const int pixelIdx)
+                  {
+                      const uint64_t packed{ m_ReprojectionTargets[pixelIdx].load(std::memory_order_relaxed) };
+                      if(packed == EMPTY_TARGET)
+                      {
+                          m_Samples[pixelIdx].isValid = false;
+                          return;
+                      }
+
+                      m_Samples[pixelIdx] = m_PreviousSamples[static_cast<uint32_t>(packed)];
+                      m_Samples[pixelIdx].depth = std::bit_cast<float>(static_cast<uint32_t>(packed >> 32));
+                      ++m_Samples[pixelIdx].age;
+                  });
+}
+
+void ReprojectionCache::Invalidate()
+{
+    for(Sample& sample : m_Samples)
+        sample.isValid = false;
+}
+
+bool ReprojectionCache::IsReusable(int pixelIdx, float depth) const
+{
+    const Sample& sample{ m_Samples[pixelIdx] };
+    if(not sample.isValid or sample.age >= 2 * m_RefreshInterval)
+        return false;
+
+    // Geometry that moved in front of the cached surface, or uncovered what was behind it, is shaded fresh
+    if(std::abs(sample.depth - depth) > DEPTH_TOLERANCE * depth)
+        return false;
+
+    // Interleaved progressive refresh so view dependent shading catches up over a few frames
+    const int px{ pixelIdx % m_Width };
+    const int py{ pixelIdx / m_Width };
+    return (static_cast<uint32_t>(px + (py * 3)) + m_FrameIndex) % m_RefreshInterval != 0;
+}
+
+void ReprojectionCache::Store(int pixelIdx, const HitRecord& hit, const ColorRGB& color, float depth)
+{
+    m_Samples[pixelIdx] = { .hit = hit, .color = color, .depth = depth, .age = 0, .isValid = hit.didHit };
+}
+}  // namespace dae
@@ -1,6 +1,7 @@
 #include "Scene.hpp"
 
 #include <algorithm>
+#include <cmath>
 
 #include "ColorRGB.hpp"
 #include "DataTypes.hpp"
@@ -17,7 +18,6 @@ namespace dae
 Scene::Scene()
     : m_Materials({ new Material_SolidColor({ .r = 1, .g = 0, .b = 0 }) })
 {
-    m_SphereGeometries.reserve(32);
     m_PlaneGeometries.reserve(32);
     m_TriangleMeshGeometries.reserve(32);
     m_Lights.reserve(32);
@@ -34,16 +34,23 @@ Scene::~Scene()
     m_Materials.clear();
 }
 
-void dae::Scene::GetClosestHit(const Ray& ray, HitRecord& closestHit) const
+void Scene::Update(Timer* pTimer)
 {
-    HitRecord currentHit{};
+    m_Camera.Update(pTimer);
 
-    for(const Sphere& sphere : m_SphereGeometries)
+    for(TriangleMesh& mesh : m_TriangleMeshGeometries)
     {
-        GeometryUtils::HitTest_Sphere(sphere, ray, currentHit);
-        if(currentHit.t < closestHit.t)
-            closestHit = currentHit;
+        if(mesh.Update())
+            MarkDirty(DirtyFlag::Geometry);
     }
+}
+
+void dae::Scene::GetClosestHit(const Ray& ray, HitRecord& closestHit) const
+{
+    HitRecord currentHit{};
+
+    if(HitTestSpheres(ray, currentHit) and currentHit.t < closestHit.t)
+        closestHit = currentHit;
 
     for(const Plane& plane : m_PlaneGeometries)
     {
@@ -69,8 +76,8 @@ void dae::Scene::GetClosestHit(const Ray& ray, HitRecord& closestHit) const
 
 bool Scene::DoesHit(const Ray& ray) const
 {
-    return std::ranges::any_of(m_SphereGeometries.cbegin(), m_SphereGeometries.cend(),
-                               [ray](const Sphere& sphere) { return GeometryUtils::HitTest_Sphere(sphere, ray); }) or
+    HitRecord temp{};
+    return HitTestSpheres(ray, temp, true) or
         std::ranges::any_of(m_PlaneGeometries.cbegin(), m_PlaneGeometries.cend(),
                             [ray](const Plane& plane) { return GeometryUtils::HitTest_Plane(plane, ray); }) or
         std::ranges::any_of(m_Triangles.cbegin(), m_Triangles.cend(),
@@ -79,9 +86,173 @@ bool Scene::DoesHit(const Ray& ray) const
                             [ray](const TriangleMesh& mesh) { return GeometryUtils::HitTest_TriangleMesh(mesh, ray); });
 }
 
+bool Scene::IsOccluded(const Ray& ray, OccluderReference& cachedOccluder) const
+{
+    if(cachedOccluder.type != OccluderType::None and DoesOccluderHit(cachedOccluder, ray))
+        return true;
+
+    for(const OccluderReference& occluder : m_OccluderOrder)
+    {
+        if(occluder.type == cachedOccluder.type and occluder.index == cachedOccluder.index)
+            continue;
+
+        if(DoesOccluderHit(occluder, ray))
+        {
+            cachedOccluder = occluder;
+            return true;
+        }
+    }
+    return false;
+}
+
+bool Scene::DoesOccluderHit(const OccluderReference& occluder, const Ray& ray) const
+{
+    // The cached reference may outlive the geometry it points at, out of range indices simply miss
+    switch(occluder.type)
+    {
+        case OccluderType::SphereBatch:
+            return occluder.index < m_SphereStore.GetPaddedSize() and
+                GeometryUtils::HitTest_SphereBatch(m_SphereStore, occluder.index, ray);
+        case OccluderType::Spheres:
+        {
+            HitRecord temp{};
+            return HitTestSpheres(ray, temp, true);
+        }
+        case OccluderType::Plane:
+            return occluder.index < m_PlaneGeometries.size() and
+                GeometryUtils::HitTest_Plane(m_PlaneGeometries[occluder.index], ray);
+        case OccluderType::Triangle:
+            return occluder.index < m_Triangles.size() and GeometryUtils::HitTest_Triangle(m_Triangles[occluder.index], ray);
+        case OccluderType::TriangleMesh:
+            return occluder.index < m_TriangleMeshGeometries.size() and
+                GeometryUtils::HitTest_TriangleMesh(m_TriangleMeshGeometries[occluder.index], ray);
+        default:
+            return false;
+    }
+}
+
+void Scene::UpdateOccluderOrder()
+{
+    if(not IsDirty(DirtyFlag::Geometry) and not m_OccluderOrder.empty())
+        return;
+
+    std::vector<RankedOccluder>& ranked{ m_RankedOccluders };
+    ranked.clear();
+    ranked.reserve((m_SphereStore.GetPaddedSize() / SphereSoA::BATCH_SIZE) + m_PlaneGeometries.size() + m_Triangles.size() +
+                   m_TriangleMeshGeometries.size());
+
+    if(m_SphereAcceleration == SphereAcceleration::None)
+    {
+        for(size_t firstIdx{}; firstIdx < m_SphereStore.GetPaddedSize(); firstIdx += SphereSoA::BATCH_SIZE)
+        {
+            float score{};
+            for(size_t sphereIdx{ firstIdx }; sphereIdx < std::min(firstIdx + SphereSoA::BATCH_SIZE, m_SphereStore.count);
+                ++sphereIdx)
+                score += PI * m_SphereStore.radiusSquared[sphereIdx];
+
+            ranked.push_back({ .occluder = { OccluderType::SphereBatch, static_cast<uint32_t>(firstIdx) }, .score = score });
+        }
+    }
+    else if(m_SphereStore.count > 0)
+    {
+        // One query through the acceleration structure beats walking the batches one by one
+        float score{};
+        for(size_t sphereIdx{}; sphereIdx < m_SphereStore.count; ++sphereIdx)
+            score += PI * m_SphereStore.radiusSquared[sphereIdx];
+
+        ranked.push_back({ .occluder = { OccluderType::Spheres, 0 }, .score = score });
+    }
+
+    for(size_t triangleIdx{}; triangleIdx < m_Triangles.size(); ++triangleIdx)
+    {
+        const Triangle& triangle{ m_Triangles[triangleIdx] };
+        const float area{ 0.5f * Vector3::Cross(triangle.v1 - triangle.v0, triangle.v2 - triangle.v0).Magnitude() };
+        ranked.push_back({ .occluder = { OccluderType::Triangle, static_cast<uint32_t>(triangleIdx) }, .score = area });
+    }
+
+    for(size_t meshIdx{}; meshIdx < m_TriangleMeshGeometries.size(); ++meshIdx)
+    {
+        const TriangleMesh& mesh{ m_TriangleMeshGeometries[meshIdx] };
+        const Vector3 extent{ mesh.maxWorldAABB - mesh.minWorldAABB };
+        const float halfSurfaceArea{ (extent.x * extent.y) + (extent.y * extent.z) + (extent.z * extent.x) };
+        ranked.push_back({ .occluder = { OccluderType::TriangleMesh, static_cast<uint32_t>(meshIdx) }, .score = halfSurfaceArea });
+    }
+
+    // Ties keep the order above, spelled out since stable_sort would allocate its merge buffer
+    std::ranges::sort(ranked,
+                      [](const RankedOccluder& lhs, const RankedOccluder& rhs)
+                      {
+                          if(lhs.score != rhs.score)
+                              return lhs.score > rhs.score;
+                          if(lhs.occluder.type != rhs.occluder.type)
+                              return lhs.occluder.type < rhs.occluder.type;
+                          return lhs.occluder.index < rhs.occluder.index;
+                      });
+
+    m_OccluderOrder.clear();
+    for(const RankedOccluder& rankedOccluder : ranked)
+        m_OccluderOrder.push_back(rankedOccluder.occluder);
+
+    // Planes go last, the enclosing walls of these scenes rarely sit between a surface and a light
+    for(size_t planeIdx{}; planeIdx < m_PlaneGeometries.size(); ++planeIdx)
+        m_OccluderOrder.push_back({ OccluderType::Plane, static_cast<uint32_t>(planeIdx) });
+}
+
+void Scene::UpdateSphereAcceleration()
+{
+    if(not m_IsSphereAccelerationDirty)
+        return;
+
+    m_IsSphereAccelerationDirty = false;
+    switch(m_SphereAcceleration)
+    {
+        case SphereAcceleration::BVH:
+        {
+            m_SphereBounds.resize(m_SphereStore.count);
+            for(size_t sphereIdx{}; sphereIdx < m_SphereStore.count; ++sphereIdx)
+            {
+                const float radius{ std::sqrt(m_SphereStore.radiusSquared[sphereIdx]) };
+                const Vector3 origin{ m_SphereStore.originX[sphereIdx], m_SphereStore.originY[sphereIdx],
+                                      m_SphereStore.originZ[sphereIdx] };
+                const Vector3 extent{ radius, radius, radius };
+                m_SphereBounds[sphereIdx] = { .min = origin - extent, .max = origin + extent };
+            }
+            m_SphereBVH.Build(m_SphereBounds);
+            break;
+        }
+        case SphereAcceleration::Grid:
+            m_SphereGrid.Build(m_SphereStore);
+            break;
+        default:
+            break;
+    }
+}
+
+bool Scene::HitTestSpheres(const Ray& ray, HitRecord& hitRecord, bool ignoreHitRecord) const
+{
+    switch(m_SphereAcceleration)
+    {
+        case SphereAcceleration::BVH:
+            return GeometryUtils::HitTest_Spheres(m_SphereBVH, m_SphereStore, ray, hitRecord, ignoreHitRecord);
+        case SphereAcceleration::Grid:
+            return GeometryUtils::HitTest_Spheres(m_SphereGrid, m_SphereStore, ray, hitRecord, ignoreHitRecord);
+        default:
+            return GeometryUtils::HitTest_Spheres(m_SphereStore, ray, hitRecord, ignoreHitRecord);
+    }
+}
+
+void Scene::UpdateLightStructures()
+{
+    if(not IsDirty(DirtyFlag::Lights))
+        return;
+
+    m_LightTree.Build(m_Lights);
+    m_LightGrid.Build(m_Lights, m_LightInfluenceThreshold);
+}
+
 #pragma region Scene Helpers
 
-Sphere* Scene::AddSphere(const Vector3& origin, float radius, unsigned char materialIndex)
+size_t Scene::AddSphere(const Vector3& origin, float radius, unsigned char materialIndex)
 {
     Sphere s;
     s.origin = origin;
@@ -89,7 +260,18 @@ Sphere* Scene::AddSphere(const Vector3& origin, float radius, unsigned char mate
     s.materialIndex = materialIndex;
 
     m_SphereGeometries.emplace_back(s);
-    return &m_SphereGeometries.back();
+    m_SphereStore.Add(s);
+    m_IsSphereAccelerationDirty = true;
+    MarkDirty(DirtyFlag::Geometry);
+    return m_SphereGeometries.size() - 1;
+}
+
+void Scene::SetSphere(size_t sphereIdx, const Sphere& sphere)
+{
+    m_SphereGeometries[sphereIdx] = sphere;
+    m_SphereStore.Set(sphereIdx, sphere);
+    m_IsSphereAccelerationDirty = true;
+    MarkDirty(DirtyFlag::Geometry);
 }
 
 Plane* Scene::AddPlane(const Vector3& origin, const Vector3& normal, unsigned char materialIndex)
@@ -100,6 +282,7 @@ Plane* Scene::AddPlane(const Vector3& origin, const Vector3& normal, unsigned ch
     p.materialIndex = materialIndex;
 
     m_PlaneGeometries.emplace_back(p);
+    MarkDirty(DirtyFlag::Geometry);
     return &m_PlaneGeometries.back();
 }
 
@@ -109,11 +292,12 @@ TriangleMesh* Scene::AddTriangleMesh(TriangleCullMode cullMode, unsigned char ma
     m.cullMode = cullMode;
     m.materialIndex = materialIndex;
 
-    m_TriangleMeshGeometries.emplace_back(m);
+    m_TriangleMeshGeometries.emplace_back(std::move(m));
+    MarkDirty(DirtyFlag::Geometry);
     return &m_TriangleMeshGeometries.back();
 }
 
-Light* Scene::AddPointLight(const Vector3& origin, float intensity, const ColorRGB& color)
+size_t Scene::AddPointLight(const Vector3& origin, float intensity, const ColorRGB& color)
 {
     Light l;
     l.origin = origin;
@@ -122,10 +306,11 @@ Light* Scene::AddPointLight(const Vector3& origin, float intensity, const ColorR
     l.type = LightType::Point;
 
     m_Lights.emplace_back(l);
-    return &m_Lights.back();
+    MarkDirty(DirtyFlag::Lights);
+    return m_Lights.size() - 1;
 }
 
-Light* Scene::AddDirectionalLight(const Vector3& direction, float intensity, const ColorRGB& color)
+size_t Scene::AddDirectionalLight(const Vector3& direction, float intensity, const ColorRGB& color)
 {
     Light l;
     l.direction = direction;
@@ -134,12 +319,65 @@ Light* Scene::AddDirectionalLight(const Vector3& direction, float intensity, con
     l.type = LightType::Directional;
 
     m_Lights.emplace_back(l);
-    return &m_Lights.back();
+    MarkDirty(DirtyFlag::Lights);
+    return m_Lights.size() - 1;
+}
+
+size_t Scene::AddRectangleLight(const Vector3& origin, const Vector3& axisU, const Vector3& axisV, float intensity,
+                                const ColorRGB& color)
+{
+    Light l;
+    l.origin = origin;
+    l.direction = Vector3::Cross(axisU, axisV).Normalized();
+    l.axisU = axisU;
+    l.axisV = axisV;
+    l.intensity = intensity;
+    l.color = color;
+    l.type = LightType::Rectangle;
+
+    m_Lights.emplace_back(l);
+    MarkDirty(DirtyFlag::Lights);
+    return m_Lights.size() - 1;
+}
+
+size_t Scene::AddDiskLight(const Vector3& origin, const Vector3& normal, float radius, float intensity, const ColorRGB& color)
+{
+    Light l;
+    l.origin = origin;
+    l.direction = normal.Normalized();
+    l.radius = radius;
+    l.intensity = intensity;
+    l.color = color;
+    l.type = LightType::Disk;
+
+    // Any in-plane basis works, the disk is rotationally symmetric
+    const Vector3 helper{ std::abs(l.direction.x) > 0.9f ? Vector3::UnitY : Vector3::UnitX };
+    l.axisU = Vector3::Cross(helper, l.direction).Normalized() * radius;
+    l.axisV = Vector3::Cross(l.direction, l.axisU).Normalized() * radius;
+
+    m_Lights.emplace_back(l);
+    MarkDirty(DirtyFlag::Lights);
+    return m_Lights.size() - 1;
+}
+
+size_t Scene::AddSphereLight(const Vector3& origin, float radius, float intensity, const ColorRGB& color)
+{
+    Light l;
+    l.origin = origin;
+    l.radius = radius;
+    l.intensity = intensity;
+    l.color = color;
+    l.type = LightType::Sphere;
+
+    m_Lights.emplace_back(l);
+    MarkDirty(DirtyFlag::Lights);
+    return m_Lights.size() - 1;
 }
 
 unsigned char Scene::AddMaterial(Material* pMaterial)
 {
     m_Materials.push_back(pMaterial);
+    MarkDirty(DirtyFlag::Materials);
     return static_cast<unsigned char>(m_Materials.size() - 1);
 }
 
@@ -259,9 +497,17 @@ void Scene_W4_BunnyScene::Initialize()
     const std::string filePath{ "resources/lowpoly_bunny.obj" };
     TriangleMesh* const pMesh = AddTriangleMesh(TriangleCullMode::BackFaceCulling, matLambert_White);
     Utils::ParseOBJ(filePath, pMesh->vertices, pMesh->indices, pMesh->normals);
+    pMesh->isWatertight = true;
+
+    // Rotates every frame, rebuilding the LBVH keeps the tree tight where refitting would let it degrade. With a cache
+    // directory the SAH tree is built once, or mapped from the cache, and refit instead.
+    if(m_BVHCacheDirectory.empty())
+        pMesh->bvhBuildMethod = WideBVH::BuildMethod::Linear;
+    else
+        pMesh->bvhCacheDirectory = m_BVHCacheDirectory;
 
     pMesh->Scale({ 2.f, 2.f, 2.f });
-    pMesh->UpdateAABB();
+    pMesh->Compact(m_QuantizePositions);
     pMesh->UpdateTransforms();
 
     // Lights
@@ -272,16 +518,12 @@ void Scene_W4_BunnyScene::Initialize()
 
 void Scene_W4_BunnyScene::Update(Timer* pTimer)
 {
-    Scene::Update(pTimer);
-
     float const rotation{ PI_DIV_2 * pTimer->GetTotal() };
     for(TriangleMesh& mesh : m_TriangleMeshGeometries)
-    {
         mesh.RotateY(rotation);
 
-        mesh.UpdateAABB();
-        mesh.UpdateTransforms();
-    }
+    // Only meshes whose rotation actually changed get re-transformed
+    Scene::Update(pTimer);
 }
 
 void Scene_W4_ReferenceScene::Initialize()
@@ -322,7 +564,6 @@ void Scene_W4_ReferenceScene::Initialize()
 
     // Meshes
     Triangle const baseTriangle{ Vector3(-.75f, 1.5f, 0.f), Vector3(.75f, 0.f, 0.f), Vector3(-.75f, 0.f, 0.f) };
-    m_TriangleMeshGeometries.reserve(3);
     AddTriangleMesh(TriangleCullMode::BackFaceCulling, matLambert_White);
     m_TriangleMeshGeometries.back().AppendTriangle(baseTriangle, true);
     m_TriangleMeshGeometries.back().Translate({ -1.75f, 4.5f, 0.f });
@@ -346,16 +587,90 @@ void Scene_W4_ReferenceScene::Initialize()
 
 void Scene_W4_ReferenceScene::Update(Timer* pTimer)
 {
-    Scene::Update(pTimer);
-
     float const rotation{ PI_DIV_2 * pTimer->GetTotal() };
     for(TriangleMesh& mesh : m_TriangleMeshGeometries)
-    {
         mesh.RotateY(rotation);
 
-        mesh.UpdateAABB();
-        mesh.UpdateTransforms();
+    // Only meshes whose rotation actually changed get re-transformed
+    Scene::Update(pTimer);
+}
+
+void Scene_W4_AreaLightScene::Initialize()
+{
+    m_Camera.origin = { 0.f, 3.f, -9.f };
+    m_Camera.UpdateFOV(45.f);
+
+    unsigned char const matCT_GrayRoughMetal{ AddMaterial(
+        new Material_CookTorrence({ .r = .972f, .g = .960f, .b = .915f }, 1.f, 1.f)) };
+    unsigned char const matCT_GrayMediumMetal{ AddMaterial(
+        new Material_CookTorrence({ .r = .972f, .g = .960f, .b = .915f }, 1.f, .6f)) };
+    unsigned char const matCT_GraySmoothMetal{ AddMaterial(
+        new Material_CookTorrence({ .r = .972f, .g = .960f, .b = .915f }, 1.f, .1f)) };
+    unsigned char const matCT_GrayRoughPlastic{ AddMaterial(
+        new Material_CookTorrence({ .r = .75f, .g = .75f, .b = .75f }, 0.f, 1.f)) };
+    unsigned char const matCT_GrayMediumPlastic{ AddMaterial(
+        new Material_CookTorrence({ .r = .75f, .g = .75f, .b = .75f }, 0.f, .6f)) };
+    unsigned char const matCT_GraySmoothPlastic{ AddMaterial(
+        new Material_CookTorrence({ .r = .75f, .g = .75f, .b = .75f }, 0.f, .1f)) };
+
+    unsigned char const matLambert_GrayBlue{ AddMaterial(new Material_Lambert({ .r = .49f, .g = .57f, .b = .57f }, 1.f)) };
+
+    // Planes
+    AddPlane({ 0.f, 0.f, 10.f }, { 0.f, 0.f, -1.f }, matLambert_GrayBlue);  // Back
+    AddPlane({ 0.f, 0.f, 0.f }, { 0.f, 1.f, 0.f }, matLambert_GrayBlue);    // Bottom
+    AddPlane({ 0.f, 10.f, 0.f }, { 0.f, -1.f, 0.f }, matLambert_GrayBlue);  // Top
+    AddPlane({ 5.f, 0.f, 0.f }, { -1.f, 0.f, 0.f }, matLambert_GrayBlue);   // Right
+    AddPlane({ -5.f, 0.f, 0.f }, { 1.f, 0.f, 0.f }, matLambert_GrayBlue);   // Left
+
+    // Spheres
+    AddSphere({ -1.75f, 1.f, 0.f }, .75f, matCT_GrayRoughMetal);
+    AddSphere({ 0.f, 1.f, 0.f }, .75f, matCT_GrayMediumMetal);
+    AddSphere({ 1.75f, 1.f, 0.f }, .75f, matCT_GraySmoothMetal);
+    AddSphere({ -1.75f, 3.f, 0.f }, .75f, matCT_GrayRoughPlastic);
+    AddSphere({ 0.f, 3.f, 0.f }, .75f, matCT_GrayMediumPlastic);
+    AddSphere({ 1.75f, 3.f, 0.f }, .75f, matCT_GraySmoothPlastic);
+
+    // Lights: a ceiling panel facing down, a disk aimed at the spheres from the front left and a bulb front right
+    AddRectangleLight({ 0.f, 6.f, 0.f }, { 1.f, 0.f, 0.f }, { 0.f, 0.f, 1.f }, 40.f, ColorRGB{ .r = 1.f, .g = .8f, .b = .6f });
+    AddDiskLight({ -3.f, 3.f, -3.f }, { 1.f, -.3f, 1.f }, .8f, 25.f, ColorRGB{ .r = .6f, .g = .7f, .b = 1.f });
+    AddSphereLight({ 3.f, 2.5f, -2.f }, .5f, 20.f, ColorRGB{ .r = 1.f, .g = .5f, .b = .5f });
+}
+
+#pragma endregion
+#pragma region SCENE SPHERE FIELD
+
+void Scene_SphereField::Initialize()
+{
+    m_Camera.origin = { 0.f, 0.f, -14.f };
+    m_Camera.UpdateFOV(60.f);
+    SetSphereAcceleration(m_Acceleration);
+
+    const unsigned char materials[]{ AddMaterial(new Material_Lambert({ .r = .49f, .g = .57f, .b = .57f }, 1.f)),
+                                     AddMaterial(new Material_Lambert({ .r = .8f, .g = .45f, .b = .3f }, 1.f)),
+                                     AddMaterial(new Material_CookTorrence({ .r = .972f, .g = .960f, .b = .915f }, 1.f, .4f)),
+                                     AddMaterial(new Material_CookTorrence({ .r = .75f, .g = .75f, .b = .75f }, 0.f, .6f)) };
+
+    // Fixed seed, every run and every acceleration structure renders the same field
+    uint32_t randomState{ 1 };
+    constexpr float halfSize{ .5f * static_cast<float>(FIELD_SIZE - 1) };
+    for(int z{}; z < FIELD_SIZE; ++z)
+    {
+        for(int y{}; y < FIELD_SIZE; ++y)
+        {
+            for(int x{}; x < FIELD_SIZE; ++x)
+            {
+                const Vector3 jitter{ RandomFloat(randomState) - .5f, RandomFloat(randomState) - .5f,
+                                      RandomFloat(randomState) - .5f };
+                const Vector3 origin{ static_cast<float>(x) - halfSize, static_cast<float>(y) - halfSize,
+                                      static_cast<float>(z) - halfSize };
+                const float radius{ .15f + (.1f * RandomFloat(randomState)) };
+                AddSphere(origin + (.4f * jitter), radius, materials[HashPCG(randomState) % std::size(materials)]);
+            }
+        }
     }
+
+    AddPointLight({ 0.f, 12.f, -12.f }, 400.f, colors::White);
+    AddDirectionalLight(Vector3{ -.3f, -1.f, .5f }.Normalized(), .5f, ColorRGB{ .r = 1.f, .g = .9f, .b = .8f });
 }
 
 #pragma endregion
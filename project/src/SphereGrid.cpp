@@ -0,0 +1,107 @@
+#include "SphereGrid.hpp"
+
+#include <algorithm>
+#include <cfloat>
+#include <cmath>
+#include <numeric>
+
+namespace dae
+{
+namespace
+{
+// Boxes are padded by this fraction of a cell, so rounding in the traversal never steps into a cell a sphere was left out of
+constexpr float CELL_PADDING{ 1e-3f };
+
+struct CellRange final
+{
+    int first[3];
+    int last[3];
+};
+}  // namespace
+
+void SphereGrid::Build(const SphereSoA& spheres)
+{
+    m_CellOffsets.clear();
+    m_CellSpheres.clear();
+    m_CellCount[0] = m_CellCount[1] = m_CellCount[2] = 0;
+
+    if(spheres.count == 0)
+        return;
+
+    m_BoundsMin = { FLT_MAX, FLT_MAX, FLT_MAX };
+    m_BoundsMax = { -FLT_MAX, -FLT_MAX, -FLT_MAX };
+    for(size_t sphereIdx{}; sphereIdx < spheres.count; ++sphereIdx)
+    {
+        const float radius{ std::sqrt(spheres.radiusSquared[sphereIdx]) };
+        const Vector3 origin{ spheres.originX[sphereIdx], spheres.originY[sphereIdx], spheres.originZ[sphereIdx] };
+        const Vector3 extent{ radius, radius, radius };
+        m_BoundsMin = Vector3::Min(m_BoundsMin, origin - extent);
+        m_BoundsMax = Vector3::Max(m_BoundsMax, origin + extent);
+    }
+
+    SelectResolution(spheres.count);
+
+    auto getCellRange = [&](size_t sphereIdx)
+    {
+        const float origin[3]{ spheres.originX[sphereIdx], spheres.originY[sphereIdx], spheres.originZ[sphereIdx] };
+        const float radius{ std::sqrt(spheres.radiusSquared[sphereIdx]) };
+
+        CellRange range{};
+        for(int axis{}; axis < 3; ++axis)
+        {
+            const float padding{ CELL_PADDING * m_CellSize[axis] };
+            const float first{ (origin[axis] - radius - padding - m_BoundsMin[axis]) * m_InverseCellSize[axis] };
+            const float last{ (origin[axis] + radius + padding - m_BoundsMin[axis]) * m_InverseCellSize[axis] };
+            range.first[axis] = std::clamp(static_cast<int>(first), 0, m_CellCount[axis] - 1);
+            range.last[axis] = std::clamp(static_cast<int>(last), 0, m_CellCount[axis] - 1);
+        }
+        return range;
+    };
+
+    auto forEachCell = [&](const CellRange& range, auto&& function)
+    {
+        for(int z{ range.first[2] }; z <= range.last[2]; ++z)
+        {
+            for(int y{ range.first[1] }; y <= range.last[1]; ++y)
+            {
+                for(int x{ range.first[0] }; x <= range.last[0]; ++x)
+                    function(GetCellIndex(x, y, z));
+            }
+        }
+    };
+
+    // Count the spheres per cell, the inclusive scan leaves every offset at the end of its cell's list
+    const size_t cellCount{ static_cast<size_t>(m_CellCount[0]) * m_CellCount[1] * m_CellCount[2] };
+    m_CellOffsets.assign(cellCount + 1, 0);
+    for(size_t sphereIdx{}; sphereIdx < spheres.count; ++sphereIdx)
+        forEachCell(getCellRange(sphereIdx), [&](int cellIdx) { ++m_CellOffsets[cellIdx]; });
+
+    std::inclusive_scan(m_CellOffsets.begin(), m_CellOffsets.end() - 1, m_CellOffsets.begin());
+    m_CellOffsets.back() = m_CellOffsets[cellCount - 1];
+
+    // Filling back to front walks every offset down to the start of its list and keeps the lists in sphere order
+    m_CellSpheres.resize(m_CellOffsets.back());
+    for(size_t sphereIdx{ spheres.count }; sphereIdx-- > 0;)
+    {
+        forEachCell(getCellRange(sphereIdx),
+                    [&](int cellIdx) { m_CellSpheres[--m_CellOffsets[cellIdx]] = static_cast<uint32_t>(sphereIdx); });
+    }
+}
+
+void SphereGrid::SelectResolution(size_t sphereCount)
+{
+    // Cubic cells sized so the grid holds about CELLS_PER_SPHERE cells per sphere, flat axes still get one cell
+    const Vector3 size{ m_BoundsMax - m_BoundsMin };
+    const float volume{ std::max(size.x, FLT_MIN) * std::max(size.y, FLT_MIN) * std::max(size.z, FLT_MIN) };
+    const float cellSize{ std::cbrt(volume / (CELLS_PER_SPHERE * static_cast<float>(sphereCount))) };
+
+    for(int axis{}; axis < 3; ++axis)
+    {
+        const float cells{ std::ceil(size[axis] / cellSize) };
+        m_CellCount[axis] = cells >= static_cast<float>(MAX_CELLS_PER_AXIS) ? MAX_CELLS_PER_AXIS
+                                                                            : std::max(static_cast<int>(cells), 1);
+        m_CellSize[axis] = size[axis] / static_cast<float>(m_CellCount[axis]);
+        m_InverseCellSize[axis] = m_CellSize[axis] > 0.f ? 1.f / m_CellSize[axis] : 0.f;
+    }
+}
+}  // namespace dae
@@ -0,0 +1,679 @@
+#include "WideBVH.hpp"
+
+#include <algorithm>
+#include <array>
+#include <bit>
+#include <cassert>
+#include <cmath>
+#include <cstdio>
+#include <cstring>
+#include <execution>
+#include <fstream>
+#include <iostream>
+#include <numeric>
+
+#include "MathHelpers.hpp"
+#include "ParallelUtils.hpp"
+
+namespace dae
+{
+namespace
+{
+constexpr uint32_t SAH_BIN_COUNT{ 16 };
+
+// Deeper ranges split at the median, which bounds the depth and with it the traversal stack
+constexpr uint32_t MAX_SAH_DEPTH{ 32 };
+
+// Smaller builds stay on the calling thread
+constexpr uint32_t PARALLEL_BUILD_THRESHOLD{ 4096 };
+constexpr size_t BUILD_CHUNK_SIZE{ 16384 };
+constexpr std::array<uint32_t, WideBVH::WIDTH> CHILD_SLOTS{ 0, 1, 2, 3, 4, 5, 6, 7 };
+
+constexpr uint32_t MORTON_CODE_BITS{ 30 };
+constexpr uint32_t RADIX_BITS{ 8 };
+constexpr uint32_t RADIX_SIZE{ 1u << RADIX_BITS };
+
+// Bump when the node layout or the builders change, older cache files then miss
+constexpr uint32_t CACHE_VERSION{ 1 };
+constexpr char CACHE_MAGIC[8]{ 'W', 'B', 'V', 'H', 'C', 'A', 'C', 'H' };
+
+// File layout: this header, the nodes, the full precision node boxes, the primitive indices
+struct alignas(64) CacheHeader final
+{
+    char magic[8]{};
+    uint32_t version{};
+    uint32_t nodeSize{};
+    uint64_t key{};
+    uint64_t nodeCount{};
+    uint64_t primitiveCount{};
+};
+static_assert(sizeof(CacheHeader) == 64, "The nodes after the header have to stay 64-byte aligned");
+
+// FNV-1a
+uint64_t HashBytes(uint64_t hash, const void* pData, size_t size)
+{
+    const auto* const pBytes{ static_cast<const unsigned char*>(pData) };
+    for(size_t byteIdx{}; byteIdx < size; ++byteIdx)
+        hash = (hash ^ pBytes[byteIdx]) * 0x100000001B3ull;
+    return hash;
+}
+
+// Covers everything that shapes the tree: the input boxes, the build method and the builder parameters
+uint64_t GetCacheKey(std::span<const WideBVH::Bounds> primitiveBounds, WideBVH::BuildMethod method)
+{
+    const uint32_t parameters[]{ CACHE_VERSION, WideBVH::WIDTH, WideBVH::MAX_LEAF_SIZE, SAH_BIN_COUNT, MAX_SAH_DEPTH,
+                                 static_cast<uint32_t>(method) };
+    uint64_t hash{ 0xCBF29CE484222325ull };
+    hash = HashBytes(hash, parameters, sizeof(parameters));
+    return HashBytes(hash, primitiveBounds.data(), primitiveBounds.size_bytes());
+}
+
+// A cache file is only trusted once every child word and primitive index it holds points inside the loaded arrays.
+// Children have to come after their parent, as BuildNode lays them out, so the tree can neither cycle nor outgrow the
+// traversal stack.
+bool IsValidCache(std::span<const WideBVH::Node> nodes, std::span<const uint32_t> primitiveIndices)
+{
+    std::vector<uint32_t> depths(nodes.size());
+    for(size_t nodeIdx{}; nodeIdx < nodes.size(); ++nodeIdx)
+    {
+        const WideBVH::Node& node{ nodes[nodeIdx] };
+        if(node.childCount > WideBVH::WIDTH)
+            return false;
+
+        for(uint32_t childIdx{}; childIdx < node.childCount; ++childIdx)
+        {
+            const uint32_t child{ node.children[childIdx] };
+            if(child & WideBVH::LEAF_FLAG)
+            {
+                const uint32_t first{ child & WideBVH::LEAF_FIRST_MASK };
+                const uint32_t count{ (child & ~WideBVH::LEAF_FLAG) >> WideBVH::LEAF_COUNT_SHIFT };
+                if(first + count > primitiveIndices.size())
+                    return false;
+                continue;
+            }
+
+            if(child <= nodeIdx or child >= nodes.size())
+                return false;
+
+            // Each level leaves at most WIDTH - 1 siblings on the stack
+            depths[child] = depths[nodeIdx] + 1;
+            if(1 + ((depths[child] + 1) * (WideBVH::WIDTH - 1)) > WideBVH::MAX_STACK_SIZE)
+                return false;
+        }
+    }
+
+    return std::ranges::all_of(primitiveIndices,
+                               [count = primitiveIndices.size()](uint32_t primitiveIdx) { return primitiveIdx < count; });
+}
+
+// Vector3::operator[] is not inline, the binning loops read centroids through this instead
+float GetComponent(const Vector3& vector, int axis)
+{
+    return axis == 0 ? vector.x : (axis == 1 ? vector.y : vector.z);
+}
+
+uint32_t GetBin(float centroid, float axisMin, float binScale)
+{
+    return std::min(static_cast<uint32_t>(binScale * (centroid - axisMin)), SAH_BIN_COUNT - 1);
+}
+
+// Largest grid step whose decoded value is still <= value
+uint8_t QuantizeDown(float value, float origin, float scale)
+{
+    if(scale <= 0.f)
+        return 0;
+
+    int quantized{ std::clamp(static_cast<int>(std::floor((value - origin) / scale)), 0, 255) };
+    while(quantized > 0 and std::fma(static_cast<float>(quantized), scale, origin) > value)
+        --quantized;
+    return static_cast<uint8_t>(quantized);
+}
+
+// Smallest grid step whose decoded value is still >= value
+uint8_t QuantizeUp(float value, float origin, float scale)
+{
+    if(scale <= 0.f)
+        return 0;
+
+    int quantized{ std::clamp(static_cast<int>(std::ceil((value - origin) / scale)), 0, 255) };
+    while(quantized < 255 and std::fma(static_cast<float>(quantized), scale, origin) < value)
+        ++quantized;
+    return static_cast<uint8_t>(quantized);
+}
+}  // namespace
+
+#pragma region Build
+void WideBVH::Build(std::span<const Bounds> primitiveBounds, BuildMethod method)
+{
+    assert(primitiveBounds.size() <= LEAF_FIRST_MASK && "Leaf words only have room for 24-bit primitive offsets");
+
+    const auto primitiveCount{ static_cast<uint32_t>(primitiveBounds.size()) };
+    m_BuildMethod = method;
+    m_Nodes.clear();
+    m_NodeBounds.clear();
+    m_PrimitiveIndices.resize(primitiveCount);
+    std::iota(m_PrimitiveIndices.begin(), m_PrimitiveIndices.end(), 0u);
+    if(primitiveCount == 0)
+    {
+        UseOwnedStorage();
+        return;
+    }
+
+    m_Centroids.resize(primitiveCount);
+    ForEachChunk(m_ChunkIndices, primitiveCount, BUILD_CHUNK_SIZE,
+                 [this, primitiveBounds](size_t begin, size_t end)
+                 {
+                     for(size_t primitiveIdx{ begin }; primitiveIdx < end; ++primitiveIdx)
+                     {
+                         const Bounds& bounds{ primitiveBounds[primitiveIdx] };
+                         m_Centroids[primitiveIdx] = (bounds.min + bounds.max) * 0.5f;
+                     }
+                 });
+
+    if(method == BuildMethod::Linear)
+        SortByMortonCode(primitiveBounds);
+
+    const PrimitiveRange root{ .first = 0,
+                               .count = primitiveCount,
+                               .bounds = GetRangeBounds(0, primitiveCount, primitiveBounds) };
+    m_Nodes.emplace_back();
+    m_NodeBounds.push_back(root.bounds);
+
+    PrimitiveRange childRanges[WIDTH]{};
+    const uint32_t childCount{ OpenRange(root, primitiveBounds, 0, childRanges) };
+
+    // The subtrees below the root share no primitives, so they are built side by side into their own arrays
+    const auto buildSubtree = [&](uint32_t childIdx)
+    {
+        m_SubtreeNodes[childIdx].clear();
+        m_SubtreeNodeBounds[childIdx].clear();
+        if(childRanges[childIdx].count > MAX_LEAF_SIZE)
+            BuildNode(childRanges[childIdx], primitiveBounds, 1, m_SubtreeNodes[childIdx], m_SubtreeNodeBounds[childIdx]);
+    };
+    if(primitiveCount >= PARALLEL_BUILD_THRESHOLD)
+        std::for_each(std::execution::par, CHILD_SLOTS.begin(), CHILD_SLOTS.begin() + childCount, buildSubtree);
+    else
+        std::for_each(CHILD_SLOTS.begin(), CHILD_SLOTS.begin() + childCount, buildSubtree);
+
+    // Appending them in child order gives the same depth-first layout as building them one after the other
+    uint32_t children[WIDTH]{};
+    Bounds childBounds[WIDTH]{};
+    for(uint32_t childIdx{}; childIdx < childCount; ++childIdx)
+    {
+        const PrimitiveRange& child{ childRanges[childIdx] };
+        childBounds[childIdx] = child.bounds;
+        if(child.count <= MAX_LEAF_SIZE)
+        {
+            children[childIdx] = LEAF_FLAG | (child.count << LEAF_COUNT_SHIFT) | child.first;
+            continue;
+        }
+
+        const auto offset{ static_cast<uint32_t>(m_Nodes.size()) };
+        children[childIdx] = offset;
+        m_Nodes.insert(m_Nodes.end(), m_SubtreeNodes[childIdx].begin(), m_SubtreeNodes[childIdx].end());
+        m_NodeBounds.insert(m_NodeBounds.end(), m_SubtreeNodeBounds[childIdx].begin(), m_SubtreeNodeBounds[childIdx].end());
+        for(size_t nodeIdx{ offset }; nodeIdx < m_Nodes.size(); ++nodeIdx)
+        {
+            Node& node{ m_Nodes[nodeIdx] };
+            for(uint32_t grandchildIdx{}; grandchildIdx < node.childCount; ++grandchildIdx)
+            {
+                if(not(node.children[grandchildIdx] & LEAF_FLAG))
+                    node.children[grandchildIdx] += offset;
+            }
+        }
+    }
+
+    Node& rootNode{ m_Nodes.front() };
+    std::copy_n(children, WIDTH, rootNode.children);
+    rootNode.childCount = childCount;
+    QuantizeChildren(rootNode, root.bounds, { childBounds, childCount });
+    UseOwnedStorage();
+}
+
+uint32_t WideBVH::BuildNode(const PrimitiveRange& range, std::span<const Bounds> primitiveBounds, uint32_t depth,
+                            std::vector<Node>& nodes, std::vector<Bounds>& nodeBounds)
+{
+    // Reserve the slot first so the node lands before its subtrees
+    const auto nodeIdx{ static_cast<uint32_t>(nodes.size()) };
+    nodes.emplace_back();
+    nodeBounds.push_back(range.bounds);
+
+    PrimitiveRange childRanges[WIDTH]{};
+    const uint32_t childCount{ OpenRange(range, primitiveBounds, depth, childRanges) };
+
+    uint32_t children[WIDTH]{};
+    Bounds childBounds[WIDTH]{};
+    for(uint32_t childIdx{}; childIdx < childCount; ++childIdx)
+    {
+        const PrimitiveRange& child{ childRanges[childIdx] };
+        childBounds[childIdx] = child.bounds;
+        children[childIdx] = child.count <= MAX_LEAF_SIZE ? LEAF_FLAG | (child.count << LEAF_COUNT_SHIFT) | child.first
+                                                          : BuildNode(child, primitiveBounds, depth + 1, nodes, nodeBounds);
+    }
+
+    // Only take the reference now, the recursion above grows nodes
+    Node& node{ nodes[nodeIdx] };
+    std::copy_n(children, WIDTH, node.children);
+    node.childCount = childCount;
+    QuantizeChildren(node, range.bounds, { childBounds, childCount });
+    return nodeIdx;
+}
+
+uint32_t WideBVH::OpenRange(const PrimitiveRange& range, std::span<const Bounds> primitiveBounds, uint32_t depth,
+                            PrimitiveRange (&childRanges)[WIDTH])
+{
+    // Open the range up into at most WIDTH children, always splitting the largest one that is too big for a leaf. LBVH
+    // splits do not look at the boxes, so there the largest is the most populated and the boxes are computed once at the end.
+    const bool isLinear{ m_BuildMethod == BuildMethod::Linear };
+    childRanges[0] = range;
+    uint32_t childCount{ 1 };
+    while(childCount < WIDTH)
+    {
+        int splitIdx{ -1 };
+        float largestSize{ -1.f };
+        for(uint32_t childIdx{}; childIdx < childCount; ++childIdx)
+        {
+            const PrimitiveRange& child{ childRanges[childIdx] };
+            const float size{ isLinear ? static_cast<float>(child.count) : child.bounds.GetHalfArea() };
+            if(child.count > MAX_LEAF_SIZE and size > largestSize)
+            {
+                splitIdx = static_cast<int>(childIdx);
+                largestSize = size;
+            }
+        }
+        if(splitIdx < 0)
+            break;
+
+        PrimitiveRange left{};
+        PrimitiveRange right{};
+        if(isLinear)
+            SplitRangeMorton(childRanges[splitIdx], left, right);
+        else
+            SplitRange(childRanges[splitIdx], primitiveBounds, depth >= MAX_SAH_DEPTH, left, right);
+
+        childRanges[splitIdx] = left;
+        childRanges[childCount++] = right;
+    }
+
+    if(isLinear)
+    {
+        for(uint32_t childIdx{}; childIdx < childCount; ++childIdx)
+        {
+            PrimitiveRange& child{ childRanges[childIdx] };
+            child.bounds = {};
+            for(uint32_t idx{ child.first }; idx < child.first + child.count; ++idx)
+                child.bounds.Grow(m_SortedBounds[idx]);
+        }
+    }
+    return childCount;
+}
+
+void WideBVH::SplitRange(const PrimitiveRange& range, std::span<const Bounds> primitiveBounds, bool forceMedian,
+                         PrimitiveRange& left, PrimitiveRange& right)
+{
+    const auto begin{ m_PrimitiveIndices.begin() + range.first };
+    const auto end{ begin + range.count };
+
+    Bounds centroidBounds{};
+    for(auto it{ begin }; it != end; ++it)
+        centroidBounds.Grow(m_Centroids[*it]);
+
+    // Binned SAH: bin the centroids along every axis and evaluate the SAH_BIN_COUNT - 1 planes between the bins
+    int bestAxis{ -1 };
+    uint32_t bestSplit{};
+    float bestBinScale{};
+    float bestCost{ FLT_MAX };
+    for(int axis{}; axis < 3 and not forceMedian; ++axis)
+    {
+        const float axisMin{ centroidBounds.min[axis] };
+        const float extent{ centroidBounds.max[axis] - axisMin };
+        if(extent <= 0.f)
+            continue;
+
+        const float binScale{ SAH_BIN_COUNT / extent };
+        Bounds binBounds[SAH_BIN_COUNT]{};
+        uint32_t binCounts[SAH_BIN_COUNT]{};
+        for(auto it{ begin }; it != end; ++it)
+        {
+            const uint32_t bin{ GetBin(GetComponent(m_Centroids[*it], axis), axisMin, binScale) };
+            binBounds[bin].Grow(primitiveBounds[*it]);
+            ++binCounts[bin];
+        }
+
+        float rightAreas[SAH_BIN_COUNT]{};
+        uint32_t rightCounts[SAH_BIN_COUNT]{};
+        Bounds accumulated{};
+        uint32_t accumulatedCount{};
+        for(uint32_t bin{ SAH_BIN_COUNT - 1 }; bin > 0; --bin)
+        {
+            accumulated.Grow(binBounds[bin]);
+            accumulatedCount += binCounts[bin];
+            rightAreas[bin] = accumulated.GetHalfArea();
+            rightCounts[bin] = accumulatedCount;
+        }
+
+        accumulated = {};
+        accumulatedCount = 0;
+        for(uint32_t split{ 1 }; split < SAH_BIN_COUNT; ++split)
+        {
+            accumulated.Grow(binBounds[split - 1]);
+            accumulatedCount += binCounts[split - 1];
+            if(accumulatedCount == 0 or rightCounts[split] == 0)
+                continue;
+
+            const float cost{ accumulated.GetHalfArea() * static_cast<float>(accumulatedCount) +
+                              rightAreas[split] * static_cast<float>(rightCounts[split]) };
+            if(cost < bestCost)
+            {
+                bestAxis = axis;
+                bestSplit = split;
+                bestBinScale = binScale;
+                bestCost = cost;
+            }
+        }
+    }
+
+    uint32_t leftCount{};
+    if(bestAxis >= 0)
+    {
+        const float axisMin{ centroidBounds.min[bestAxis] };
+        const auto isLeft = [&](uint32_t primitiveIdx)
+        { return GetBin(GetComponent(m_Centroids[primitiveIdx], bestAxis), axisMin, bestBinScale) < bestSplit; };
+        const auto middle{ std::partition(begin, end, isLeft) };
+        leftCount = static_cast<uint32_t>(middle - begin);
+    }
+
+    // Coincident centroids or a forced split: halve the range along its widest axis
+    if(leftCount == 0 or leftCount == range.count)
+    {
+        const Vector3 extent{ centroidBounds.max - centroidBounds.min };
+        const int axis{ extent.x >= extent.y and extent.x >= extent.z ? 0 : (extent.y >= extent.z ? 1 : 2) };
+        leftCount = range.count / 2;
+        const auto isCloser = [&](uint32_t lhs, uint32_t rhs)
+        { return GetComponent(m_Centroids[lhs], axis) < GetComponent(m_Centroids[rhs], axis); };
+        std::nth_element(begin, begin + leftCount, end, isCloser);
+    }
+
+    const uint32_t rightFirst{ range.first + leftCount };
+    const uint32_t rightCount{ range.count - leftCount };
+    left = { .first = range.first, .count = leftCount, .bounds = GetRangeBounds(range.first, leftCount, primitiveBounds) };
+    right = { .first = rightFirst, .count = rightCount, .bounds = GetRangeBounds(rightFirst, rightCount, primitiveBounds) };
+}
+
+void WideBVH::SplitRangeMorton(const PrimitiveRange& range, PrimitiveRange& left, PrimitiveRange& right) const
+{
+    // The range is sorted and its codes share every bit above the highest one where the first and last code differ,
+    // the split goes where that bit turns on. Identical codes have nothing to split on and are halved instead.
+    const auto codesBegin{ m_MortonCodes.begin() + range.first };
+    const auto codesEnd{ codesBegin + range.count };
+    const uint32_t differingBits{ *codesBegin ^ *(codesEnd - 1) };
+
+    uint32_t leftCount{ range.count / 2 };
+    if(differingBits != 0)
+    {
+        const uint32_t splitBit{ std::bit_floor(differingBits) };
+        const auto isLeft = [splitBit](uint32_t code) { return (code & splitBit) == 0; };
+        const auto middle{ std::partition_point(codesBegin, codesEnd, isLeft) };
+        leftCount = static_cast<uint32_t>(middle - codesBegin);
+    }
+
+    // OpenRange fills in the boxes
+    left = { .first = range.first, .count = leftCount, .bounds = {} };
+    right = { .first = range.first + leftCount, .count = range.count - leftCount, .bounds = {} };
+}
+
+void WideBVH::SortByMortonCode(std::span<const Bounds> primitiveBounds)
+{
+    const auto primitiveCount{ static_cast<uint32_t>(m_PrimitiveIndices.size()) };
+
+    Bounds centroidBounds{};
+    for(const Vector3& centroid : m_Centroids)
+        centroidBounds.Grow(centroid);
+
+    // 10 bits per axis over the centroid bounds, a flat axis maps everything to 0
+    const Vector3 extent{ centroidBounds.max - centroidBounds.min };
+    const Vector3 gridScale{ extent.x > 0.f ? 1023.f / extent.x : 0.f, extent.y > 0.f ? 1023.f / extent.y : 0.f,
+                             extent.z > 0.f ? 1023.f / extent.z : 0.f };
+
+    m_MortonCodes.resize(primitiveCount);
+    ForEachChunk(m_ChunkIndices, primitiveCount, BUILD_CHUNK_SIZE,
+                 [this, &centroidBounds, &gridScale](size_t begin, size_t end)
+                 {
+                     for(size_t primitiveIdx{ begin }; primitiveIdx < end; ++primitiveIdx)
+                     {
+                         const Vector3 cell{ m_Centroids[primitiveIdx] - centroidBounds.min };
+                         const auto x{ static_cast<uint32_t>(std::min(cell.x * gridScale.x, 1023.f)) };
+                         const auto y{ static_cast<uint32_t>(std::min(cell.y * gridScale.y, 1023.f)) };
+                         const auto z{ static_cast<uint32_t>(std::min(cell.z * gridScale.z, 1023.f)) };
+                         m_MortonCodes[primitiveIdx] = (SpreadBits(x) << 2) | (SpreadBits(y) << 1) | SpreadBits(z);
+                     }
+                 });
+
+    // LSD radix sort, 8 bits a pass. Every chunk counts its digits, an exclusive scan over (digit, chunk) turns the counts
+    // into write offsets, and the chunks scatter in parallel. Chunks and elements keep their order, so the sort is stable.
+    const size_t chunkCount{ (primitiveCount + BUILD_CHUNK_SIZE - 1) / BUILD_CHUNK_SIZE };
+    m_SortedCodes.resize(primitiveCount);
+    m_SortedIndices.resize(primitiveCount);
+    m_RadixHistograms.resize(chunkCount * RADIX_SIZE);
+    for(uint32_t shift{}; shift < MORTON_CODE_BITS; shift += RADIX_BITS)
+    {
+        std::fill(m_RadixHistograms.begin(), m_RadixHistograms.end(), 0u);
+        ForEachChunk(m_ChunkIndices, primitiveCount, BUILD_CHUNK_SIZE,
+                     [this, shift](size_t begin, size_t end)
+                     {
+                         uint32_t* const pHistogram{ &m_RadixHistograms[(begin / BUILD_CHUNK_SIZE) * RADIX_SIZE] };
+                         for(size_t idx{ begin }; idx < end; ++idx)
+                             ++pHistogram[(m_MortonCodes[idx] >> shift) & (RADIX_SIZE - 1)];
+                     });
+
+        uint32_t offset{};
+        for(uint32_t digit{}; digit < RADIX_SIZE; ++digit)
+        {
+            for(size_t chunkIdx{}; chunkIdx < chunkCount; ++chunkIdx)
+            {
+                const uint32_t count{ m_RadixHistograms[(chunkIdx * RADIX_SIZE) + digit] };
+                m_RadixHistograms[(chunkIdx * RADIX_SIZE) + digit] = offset;
+                offset += count;
+            }
+        }
+
+        ForEachChunk(m_ChunkIndices, primitiveCount, BUILD_CHUNK_SIZE,
+                     [this, shift](size_t begin, size_t end)
+                     {
+                         uint32_t* const pOffsets{ &m_RadixHistograms[(begin / BUILD_CHUNK_SIZE) * RADIX_SIZE] };
+                         for(size_t idx{ begin }; idx < end; ++idx)
+                         {
+                             const uint32_t destination{ pOffsets[(m_MortonCodes[idx] >> shift) & (RADIX_SIZE - 1)]++ };
+                             m_SortedCodes[destination] = m_MortonCodes[idx];
+                             m_SortedIndices[destination] = m_PrimitiveIndices[idx];
+                         }
+                     });
+
+        m_MortonCodes.swap(m_SortedCodes);
+        m_PrimitiveIndices.swap(m_SortedIndices);
+    }
+
+    // Every level of the build reads the boxes of whole ranges, in sorted order those reads are sequential
+    m_SortedBounds.resize(primitiveCount);
+    ForEachChunk(m_ChunkIndices, primitiveCount, BUILD_CHUNK_SIZE,
+                 [this, primitiveBounds](size_t begin, size_t end)
+                 {
+                     for(size_t idx{ begin }; idx < end; ++idx)
+                         m_SortedBounds[idx] = primitiveBounds[m_PrimitiveIndices[idx]];
+                 });
+}
+#pragma endregion
+
+#pragma region Refit
+void WideBVH::Refit(std::span<const Bounds> primitiveBounds)
+{
+    // The mapping is read-only, the first refit after loading a cache copies the tree out
+    if(IsMapped())
+    {
+        m_Nodes.assign(m_NodeView.begin(), m_NodeView.end());
+        m_NodeBounds.assign(m_NodeBoundsView.begin(), m_NodeBoundsView.end());
+        m_PrimitiveIndices.assign(m_PrimitiveIndexView.begin(), m_PrimitiveIndexView.end());
+        UseOwnedStorage();
+    }
+
+    // Depth-first order puts every child after its parent, so a reverse sweep always sees the children first
+    for(size_t nodeIdx{ m_Nodes.size() }; nodeIdx-- > 0;)
+    {
+        Node& node{ m_Nodes[nodeIdx] };
+        Bounds childBounds[WIDTH]{};
+        Bounds nodeBounds{};
+        for(uint32_t childIdx{}; childIdx < node.childCount; ++childIdx)
+        {
+            const uint32_t child{ node.children[childIdx] };
+            if(child & LEAF_FLAG)
+            {
+                const uint32_t count{ (child & ~LEAF_FLAG) >> LEAF_COUNT_SHIFT };
+                childBounds[childIdx] = GetRangeBounds(child & LEAF_FIRST_MASK, count, primitiveBounds);
+            }
+            else
+                childBounds[childIdx] = m_NodeBounds[child];
+
+            nodeBounds.Grow(childBounds[childIdx]);
+        }
+
+        m_NodeBounds[nodeIdx] = nodeBounds;
+        QuantizeChildren(node, nodeBounds, { childBounds, node.childCount });
+    }
+}
+#pragma endregion
+
+#pragma region Helpers
+WideBVH::Bounds WideBVH::GetRangeBounds(uint32_t first, uint32_t count, std::span<const Bounds> primitiveBounds) const
+{
+    Bounds bounds{};
+    for(uint32_t idx{ first }; idx < first + count; ++idx)
+        bounds.Grow(primitiveBounds[m_PrimitiveIndices[idx]]);
+    return bounds;
+}
+
+void WideBVH::QuantizeChildren(Node& node, const Bounds& nodeBounds, std::span<const Bounds> childBounds)
+{
+    uint8_t* const quantizedMin[3]{ node.minX, node.minY, node.minZ };
+    uint8_t* const quantizedMax[3]{ node.maxX, node.maxY, node.maxZ };
+    for(int axis{}; axis < 3; ++axis)
+    {
+        // Round the step up until the last grid line covers the node, a flat axis keeps a zero step and decodes exactly
+        const float origin{ nodeBounds.min[axis] };
+        float scale{ (nodeBounds.max[axis] - origin) / 255.f };
+        while(std::fma(255.f, scale, origin) < nodeBounds.max[axis])
+            scale = std::nextafter(scale, FLT_MAX);
+
+        node.origin[axis] = origin;
+        node.scale[axis] = scale;
+
+        for(uint32_t childIdx{}; childIdx < WIDTH; ++childIdx)
+        {
+            // Unused slots get an inverted box, on top of being masked out by childCount
+            if(childIdx >= childBounds.size())
+            {
+                quantizedMin[axis][childIdx] = 255;
+                quantizedMax[axis][childIdx] = 0;
+                continue;
+            }
+
+            quantizedMin[axis][childIdx] = QuantizeDown(childBounds[childIdx].min[axis], origin, scale);
+            quantizedMax[axis][childIdx] = QuantizeUp(childBounds[childIdx].max[axis], origin, scale);
+        }
+    }
+}
+#pragma endregion
+
+#pragma region Cache
+void WideBVH::BuildCached(std::span<const Bounds> primitiveBounds, BuildMethod method, const std::filesystem::path& directory)
+{
+    const uint64_t key{ GetCacheKey(primitiveBounds, method) };
+    char fileName[32]{};
+    std::snprintf(fileName, sizeof(fileName), "%016llx.bvh", static_cast<unsigned long long>(key));
+    const std::filesystem::path path{ directory / fileName };
+
+    if(LoadCache(path, key, primitiveBounds.size()))
+        return;
+
+    Build(primitiveBounds, method);
+    if(not SaveCache(path, key))
+        std::cerr << "Could not write the BVH cache " << path << '\n';
+}
+
+bool WideBVH::LoadCache(const std::filesystem::path& path, uint64_t key, size_t primitiveCount)
+{
+    auto pFile{ std::make_unique<MappedFile>(path) };
+    if(not pFile->IsValid() or pFile->GetData().size() < sizeof(CacheHeader))
+        return false;
+
+    const std::span<const std::byte> data{ pFile->GetData() };
+    CacheHeader header{};
+    std::memcpy(&header, data.data(), sizeof(header));
+    if(std::memcmp(header.magic, CACHE_MAGIC, sizeof(CACHE_MAGIC)) != 0 or header.version != CACHE_VERSION or
+       header.nodeSize != sizeof(Node) or header.key != key or header.primitiveCount != primitiveCount or header.nodeCount == 0)
+        return false;
+
+    // Nodes start on a multiple of 64 bytes into a page aligned mapping, so they keep their alignment
+    const size_t nodeBoundsOffset{ sizeof(CacheHeader) + (header.nodeCount * sizeof(Node)) };
+    const size_t primitiveIndicesOffset{ nodeBoundsOffset + (header.nodeCount * sizeof(Bounds)) };
+    if(data.size() < primitiveIndicesOffset + (header.primitiveCount * sizeof(uint32_t)))
+        return false;
+
+    const std::span<const Node> nodes{ reinterpret_cast<const Node*>(data.data() + sizeof(CacheHeader)), header.nodeCount };
+    const std::span<const uint32_t> primitiveIndices{ reinterpret_cast<const uint32_t*>(data.data() + primitiveIndicesOffset),
+                                                      header.primitiveCount };
+    if(not IsValidCache(nodes, primitiveIndices))
+        return false;
+
+    m_Nodes.clear();
+    m_NodeBounds.clear();
+    m_PrimitiveIndices.clear();
+    m_NodeView = nodes;
+    m_NodeBoundsView = { reinterpret_cast<const Bounds*>(data.data() + nodeBoundsOffset), header.nodeCount };
+    m_PrimitiveIndexView = primitiveIndices;
+    m_pMappedFile = std::move(pFile);
+    return true;
+}
+
+bool WideBVH::SaveCache(const std::filesystem::path& path, uint64_t key) const
+{
+    std::error_code error{};
+    std::filesystem::create_directories(path.parent_path(), error);
+
+    // Written under a temporary name and renamed, so an interrupted run never leaves a truncated cache behind
+    std::filesystem::path temporaryPath{ path };
+    temporaryPath += ".tmp";
+    {
+        std::ofstream file{ temporaryPath, std::ios::binary | std::ios::trunc };
+        if(not file)
+            return false;
+
+        CacheHeader header{ .version = CACHE_VERSION,
+                            .nodeSize = sizeof(Node),
+                            .key = key,
+                            .nodeCount = m_NodeView.size(),
+                            .primitiveCount = m_PrimitiveIndexView.size() };
+        std::memcpy(header.magic, CACHE_MAGIC, sizeof(CACHE_MAGIC));
+
+        file.write(reinterpret_cast<const char*>(&header), sizeof(header));
+        file.write(reinterpret_cast<const char*>(m_NodeView.data()), static_cast<std::streamsize>(m_NodeView.size_bytes()));
+        file.write(reinterpret_cast<const char*>(m_NodeBoundsView.data()),
+                   static_cast<std::streamsize>(m_NodeBoundsView.size_bytes()));
+        file.write(reinterpret_cast<const char*>(m_PrimitiveIndexView.data()),
+                   static_cast<std::streamsize>(m_PrimitiveIndexView.size_bytes()));
+        if(not file)
+            return false;
+    }
+
+    std::filesystem::rename(temporaryPath, path, error);
+    return not error;
+}
+
+void WideBVH::UseOwnedStorage()
+{
+    m_NodeView = m_Nodes;
+    m_NodeBoundsView = m_NodeBounds;
+    m_PrimitiveIndexView = m_PrimitiveIndices;
+    m_pMappedFile.reset();
+}
+#pragma endregion
+}  // namespace dae
@@ -4,15 +4,16 @@
 #undef main
 
 // Standard includes
+#include <cstdlib>
+#include <cstring>
+#include <filesystem>
 #include <iostream>
 
 // Project includes
 #include "Renderer.hpp"
 #include "Scene.hpp"
 #include "Timer.hpp"
-#if defined(_DEBUG)
 #include "LeakDetector.hpp"
-#endif
 
 using namespace dae;
 
@@ -24,15 +25,41 @@ void ShutDown(SDL_Window* pWindow)
 
 int main(int argc, char* args[])
 {
-    // Unreferenced parameters
-    (void)argc;
-    (void)args;
-
 // Leak detection
 #if defined(_DEBUG)
     LeakDetector detector{};
 #endif
 
+    // --frames N quits after N frames, --assert-no-allocations N fails once a frame after the first N allocates,
+    // --sphere-benchmark none|bvh|grid benchmarks the sphere field with that sphere acceleration structure,
+    // --area-lights N renders the area light scene with N shadow samples per area light and hit,
+    // --bunny float|quantized renders the bunny scene with float or 16-bit quantized mesh positions,
+    // --bvh-cache on renders the bunny scene with its SAH tree cached in resources/bvhcache next to the executable
+    int frameLimit = -1;
+    const char* sphereBenchmark = nullptr;
+    int areaLightSamples = 0;
+    const char* bunnyPositions = nullptr;
+    bool useBVHCache = false;
+    for(int argIdx = 1; argIdx + 1 < argc; ++argIdx)
+    {
+        if(std::strcmp(args[argIdx], "--frames") == 0)
+            frameLimit = std::atoi(args[++argIdx]);
+        else if(std::strcmp(args[argIdx], "--assert-no-allocations") == 0)
+        {
+            // Without the profiler nothing would be checked, fail instead of letting a CI gate pass
+            if(!LeakDetector::EnableAllocationAssertion(std::atoi(args[++argIdx])))
+                return 1;
+        }
+        else if(std::strcmp(args[argIdx], "--sphere-benchmark") == 0)
+            sphereBenchmark = args[++argIdx];
+        else if(std::strcmp(args[argIdx], "--area-lights") == 0)
+            areaLightSamples = std::atoi(args[++argIdx]);
+        else if(std::strcmp(args[argIdx], "--bunny") == 0)
+            bunnyPositions = args[++argIdx];
+        else if(std::strcmp(args[argIdx], "--bvh-cache") == 0)
+            useBVHCache = std::strcmp(args[++argIdx], "on") == 0;
+    }
+
     // Create window + surfaces
     SDL_Init(SDL_INIT_VIDEO);
 
@@ -50,20 +77,54 @@ int main(int argc, char* args[])
     auto* const pRenderer = new Renderer(pWindow);
 
     // auto* const pScene = new Scene_W1();
-    auto* const pScene = new Scene_W4_ReferenceScene();
+    Scene* pScene = nullptr;
+    if(areaLightSamples > 0)
+    {
+        pScene = new Scene_W4_AreaLightScene();
+        pRenderer->SetAreaLightSamples(static_cast<uint32_t>(areaLightSamples));
+    }
+    else if(bunnyPositions != nullptr || useBVHCache)
+    {
+        // The resources are copied next to the executable, the working directory may be anywhere and read-only
+        std::filesystem::path bvhCacheDirectory{};
+        if(useBVHCache)
+        {
+            if(char* const pBasePath = SDL_GetBasePath())
+            {
+                bvhCacheDirectory = std::filesystem::path{ pBasePath } / "resources" / "bvhcache";
+                SDL_free(pBasePath);
+            }
+            else
+                std::cerr << "Executable directory unknown, the BVH cache stays off: " << SDL_GetError() << '\n';
+        }
+        const bool quantizePositions = bunnyPositions != nullptr && std::strcmp(bunnyPositions, "quantized") == 0;
+        pScene = new Scene_W4_BunnyScene(quantizePositions, bvhCacheDirectory);
+    }
+    else if(sphereBenchmark == nullptr)
+        pScene = new Scene_W4_ReferenceScene();
+    else if(std::strcmp(sphereBenchmark, "bvh") == 0)
+        pScene = new Scene_SphereField(Scene::SphereAcceleration::BVH);
+    else if(std::strcmp(sphereBenchmark, "grid") == 0)
+        pScene = new Scene_SphereField(Scene::SphereAcceleration::Grid);
+    else
+        pScene = new Scene_SphereField(Scene::SphereAcceleration::None);
     pScene->Initialize();
 
     // Start loop
     pTimer->Start();
 
     // Start Benchmark
-    // pTimer->StartBenchmark();
+    if(sphereBenchmark != nullptr)
+        pTimer->StartBenchmark();
 
     float printTimer = 0.F;
+    int frameCount = 0;
     bool isLooping = true;
     bool takeScreenshot = false;
     while(isLooping)
     {
+        LeakDetector::BeginFrame();
+
         //--------- Get input events ---------
         SDL_Event e;
         while(SDL_PollEvent(&e))
@@ -84,10 +145,18 @@ int main(int argc, char* args[])
         }
 
         //--------- Update ---------
-        pScene->Update(pTimer);
+        {
+            const LeakDetector::AllocationTag tag{ "Scene::Update" };
+            pScene->Update(pTimer);
+        }
 
         //--------- Render ---------
-        pRenderer->Render(pScene);
+        {
+            // Steady-state frames should only use the frame arena and buffers kept from earlier frames
+            const LeakDetector::AllocationTag tag{ "Renderer::Render" };
+            pRenderer->Render(pScene);
+        }
+        LeakDetector::EndFrame();
 
         //--------- Timer ---------
         pTimer->Update();
@@ -96,6 +165,7 @@ int main(int argc, char* args[])
         {
             printTimer = 0.F;
             std::cout << "dFPS: " << pTimer->GetdFPS() << '\n';
+            LeakDetector::PrintAllocationReport(std::cout);
         }
 
         // Save screenshot after full render
@@ -107,6 +177,9 @@ int main(int argc, char* args[])
                 std::cout << "Something went wrong. Screenshot not saved!" << '\n';
             takeScreenshot = false;
         }
+
+        if(frameLimit >= 0 && ++frameCount >= frameLimit)
+            isLooping = false;
     }
     pTimer->Stop();
 